@@ -19,6 +19,7 @@ if __name__ == '__main__':
     args = [
         'emacs', '-q', '--batch', '-L', cwd,
         '--eval', '(setq tripoli-inhibit-init t)',
+        '--eval', '(setq tripoli-site-import t)',
         '-l', 'libtripoli',
         '--eval', '(tripoli-exec-str "{}")'.format(code)
     ]
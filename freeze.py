@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+
+"""Generate C source embedding the tripoli package as frozen modules.
+
+Usage: freeze.py SOURCE_DIR OUTPUT
+
+The code objects are marshalled by the running interpreter, which must be the
+same Python version that libtripoli is linked against.
+"""
+
+import marshal
+import os
+import sys
+from os.path import join, relpath
+
+
+def modules(root):
+    for dirpath, dirnames, filenames in os.walk(join(root, 'tripoli')):
+        dirnames.sort()
+        for filename in sorted(filenames):
+            if not filename.endswith('.py'):
+                continue
+            path = join(dirpath, filename)
+            parts = relpath(path, root)[:-3].split(os.sep)
+            package = parts[-1] == '__init__'
+            if package:
+                parts.pop()
+            yield '.'.join(parts), path, package
+
+
+def freeze(root, output):
+    lines = [
+        '// Generated by freeze.py, do not edit',
+        '',
+        '#include <Python.h>',
+        '',
+        '#include "frozen.h"',
+        '',
+        '#if PY_MAJOR_VERSION != {} || PY_MINOR_VERSION != {}'.format(*sys.version_info[:2]),
+        '#error "The frozen modules were compiled by Python {}.{}"'.format(*sys.version_info[:2]),
+        '#endif',
+        '',
+    ]
+
+    entries = []
+    for name, path, package in modules(root):
+        with open(path, encoding='utf-8') as f:
+            code = compile(f.read(), '<frozen {}>'.format(name), 'exec', dont_inherit=True)
+        data = marshal.dumps(code)
+        ident = 'M_' + name.replace('.', '__')
+        lines.append('static const unsigned char {}[] = {{'.format(ident))
+        for i in range(0, len(data), 16):
+            lines.append('    ' + ' '.join('{},'.format(b) for b in data[i:i+16]))
+        lines.extend(['};', ''])
+        entries.append('    {{"{}", {}, (int)sizeof({}), {}}},'.format(
+            name, ident, ident, 'true' if package else 'false'
+        ))
+
+    lines.append('const FrozenModule tripoli_frozen_modules[] = {')
+    lines.extend(entries)
+    lines.extend(['    {NULL, NULL, 0, false},', '};', ''])
+
+    with open(output, 'w') as f:
+        f.write('\n'.join(lines))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        sys.exit(__doc__.strip())
+    freeze(sys.argv[1], sys.argv[2])
@@ -0,0 +1,328 @@
+#include <Python.h>
+
+#include "emacs-interface.h"
+#include "error.h"
+#include "object.h"
+
+#include "batch.h"
+
+
+
+// Batch results
+
+DOCSTRING(BatchResult,
+          "The result of a call recorded in a :class:`.Batch`. These may be passed as "
+          "arguments to later calls in the same batch.")
+
+void BatchResult_dealloc(BatchResult *self)
+{
+    Py_XDECREF(self->value);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+PyObject *BatchResult_value(PyObject *self, void *closure)
+{
+    UNUSED(closure);
+    PyObject *value = ((BatchResult *)self)->value;
+    if (!value) {
+        PyErr_SetString(PyExc_RuntimeError, "Batch has not been run");
+        return NULL;
+    }
+    Py_INCREF(value);
+    return value;
+}
+
+PyObject *BatchResult_repr(PyObject *self)
+{
+    BatchResult *result = (BatchResult *)self;
+    if (result->value)
+        return PyUnicode_FromFormat("<BatchResult %zd: %R>", result->index, result->value);
+    return PyUnicode_FromFormat("<BatchResult %zd>", result->index);
+}
+
+static PyGetSetDef BatchResult_getset[] = {
+    {"value", BatchResult_value, NULL,
+     "The materialized result. Only available after the batch has run.", NULL},
+    {NULL},
+};
+
+PyTypeObject BatchResultType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "emacs_raw.BatchResult",          // tp_name
+    sizeof(BatchResult),              // tp_basicsize
+    0,                                // tp_itemsize
+    (destructor)BatchResult_dealloc,  // tp_dealloc
+    0,                                // tp_print
+    0,                                // tp_getattr
+    0,                                // tp_setattr
+    0,                                // tp_as_async
+    BatchResult_repr,                 // tp_repr
+    0,                                // tp_as_number
+    0,                                // tp_as_sequence
+    0,                                // tp_as_mapping
+    0,                                // tp_hash
+    0,                                // tp_call
+    0,                                // tp_str
+    0,                                // tp_getattro
+    0,                                // tp_setattro
+    0,                                // tp_as_buffer
+    Py_TPFLAGS_DEFAULT,               // tp_flags
+    __doc_BatchResult,                // tp_doc
+    0,                                // tp_traverse
+    0,                                // tp_clear
+    0,                                // tp_richcompare
+    0,                                // tp_weaklistoffset
+    0,                                // tp_iter
+    0,                                // tp_internext
+    0,                                // tp_methods
+    0,                                // tp_members
+    BatchResult_getset,               // tp_getset
+    0,                                // tp_base
+    0,                                // tp_dict
+    0,                                // tp_descr_get
+    0,                                // tp_descr_set
+    0,                                // tp_dictoffset
+    0,                                // tp_init
+    0,                                // tp_alloc
+    0,                                // tp_new
+    0,                                // tp_free
+    0,                                // tp_is_gc
+    0,                                // tp_bases
+    0,                                // tp_mro
+    0,                                // tp_cache
+    0,                                // tp_subclasses
+    0,                                // tp_weaklist
+    0,                                // tp_del
+    0,                                // tp_version_tag
+    0,                                // tp_finalize
+};
+
+
+
+// Batches
+
+// Results refer to their batch by serial number rather than by pointer, so
+// that they don't keep it alive (there is no cycle collection for these)
+static size_t __batch_serial = 0;
+
+PUBLIC_DOCSTRING(py_batch,
+                 "batch()\n\n"
+                 "Creates a new :class:`.Batch`.")
+PyObject *py_batch(PyObject *self, PyObject *args)
+{
+    UNUSED(self);
+    if (!PyArg_ParseTuple(args, ""))
+        return NULL;
+    Batch *batch = (Batch *)BatchType.tp_alloc(&BatchType, 0);
+    if (batch) {
+        batch->calls = PyList_New(0);
+        batch->serial = ++__batch_serial;
+    }
+    return (PyObject *)batch;
+}
+
+void Batch_dealloc(Batch *self)
+{
+    Py_XDECREF(self->calls);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+DOCSTRING(Batch_call,
+          "call(func, *args)\n\n"
+          "Records a call to `func` with the given arguments, and returns a "
+          ":class:`.BatchResult` for it. Arguments are coerced to Emacs objects when the "
+          "batch runs, except results of earlier calls in the same batch, which refer to "
+          "the result of that call.")
+PyObject *Batch_call(PyObject *self, PyObject *args)
+{
+    Batch *batch = (Batch *)self;
+    if (PyTuple_Size(args) < 1) {
+        PyErr_SetString(PyExc_TypeError, "Expected a function");
+        return NULL;
+    }
+
+    for (Py_ssize_t i = 1; i < PyTuple_GET_SIZE(args); i++) {
+        PyObject *arg = PyTuple_GET_ITEM(args, i);
+        if (!PyObject_TypeCheck(arg, &BatchResultType))
+            continue;
+        if (((BatchResult *)arg)->batch != batch->serial) {
+            PyErr_SetString(PyExc_ValueError, "Result belongs to a different batch");
+            return NULL;
+        }
+        ((BatchResult *)arg)->uses++;
+    }
+
+    BatchResult *result = (BatchResult *)BatchResultType.tp_alloc(&BatchResultType, 0);
+    if (!result)
+        return NULL;
+    result->batch = batch->serial;
+    result->index = PyList_GET_SIZE(batch->calls);
+
+    PyObject *call = PyTuple_Pack(2, args, (PyObject *)result);
+    if (!call || PyList_Append(batch->calls, call) < 0) {
+        Py_XDECREF(call);
+        Py_DECREF(result);
+        return NULL;
+    }
+    Py_DECREF(call);
+
+    return (PyObject *)result;
+}
+
+DOCSTRING(Batch_run,
+          "run()\n\n"
+          "Runs all recorded calls in order. Errors are checked once, after the last call, "
+          "and raised as usual. Only results that are still referenced from outside the "
+          "batch are materialized as :class:`.EmacsObject` instances. A batch may be run "
+          "more than once.")
+PyObject *Batch_run(PyObject *self, PyObject *args)
+{
+    UNUSED(args);
+    Batch *batch = (Batch *)self;
+    Py_ssize_t ncalls = PyList_GET_SIZE(batch->calls);
+    emacs_value *results = (emacs_value *)malloc((ncalls > 0 ? ncalls : 1) * sizeof(emacs_value));
+
+    // If a call exits non-locally, the remaining calls return immediately
+    // without doing anything, so it is enough to check for errors at the end
+    bool success = true;
+    for (Py_ssize_t i = 0; i < ncalls && success; i++) {
+        PyObject *call = PyTuple_GET_ITEM(PyList_GET_ITEM(batch->calls, i), 0);
+        Py_ssize_t nargs = PyTuple_GET_SIZE(call) - 1;
+        emacs_value func, argv[nargs > 0 ? nargs : 1];
+
+        success = EmacsObject__coerce(PyTuple_GET_ITEM(call, 0), true, &func);
+        for (Py_ssize_t j = 0; j < nargs && success; j++) {
+            PyObject *arg = PyTuple_GET_ITEM(call, j + 1);
+            if (PyObject_TypeCheck(arg, &BatchResultType))
+                argv[j] = results[((BatchResult *)arg)->index];
+            else
+                success = EmacsObject__coerce(arg, false, &argv[j]);
+        }
+
+        if (success)
+            results[i] = em_funcall(func, Py_SAFE_DOWNCAST(nargs, Py_ssize_t, int), argv);
+    }
+
+    // An earlier call may have exited non-locally before an argument failed
+    // to coerce. That exit must be cleared, and it is the error reported.
+    if (propagate_emacs_error() || !success) {
+        free(results);
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_TypeError, "Unable to coerce to Emacs Object");
+        return NULL;
+    }
+
+    for (Py_ssize_t i = 0; i < ncalls; i++) {
+        BatchResult *result = (BatchResult *)PyTuple_GET_ITEM(PyList_GET_ITEM(batch->calls, i), 1);
+        Py_CLEAR(result->value);
+
+        // The batch itself holds one reference, and later calls one each
+        if (Py_REFCNT(result) > 1 + result->uses)
+            result->value = EmacsObject__make(&EmacsObjectType, results[i]);
+    }
+
+    free(results);
+    Py_RETURN_NONE;
+}
+
+DOCSTRING(Batch_enter,
+          "__enter__()\n\n"
+          "Returns the batch itself.")
+PyObject *Batch_enter(PyObject *self, PyObject *args)
+{
+    UNUSED(args);
+    Py_INCREF(self);
+    return self;
+}
+
+DOCSTRING(Batch_exit,
+          "__exit__(type, value, traceback)\n\n"
+          "Runs the batch, unless an exception is being raised.")
+PyObject *Batch_exit(PyObject *self, PyObject *args)
+{
+    PyObject *etype, *evalue, *etb;
+    if (!PyArg_ParseTuple(args, "OOO", &etype, &evalue, &etb))
+        return NULL;
+    if (etype == Py_None) {
+        PyObject *ret = Batch_run(self, NULL);
+        if (!ret)
+            return NULL;
+        Py_DECREF(ret);
+    }
+    Py_RETURN_FALSE;
+}
+
+#define METHOD(name, pyname, args)                                      \
+    {#pyname, (PyCFunction)Batch_ ## name, METH_ ## args, __doc_Batch_ ## name}
+
+static PyMethodDef Batch_methods[] = {
+    METHOD(call, call, VARARGS),
+    METHOD(run, run, NOARGS),
+    METHOD(enter, __enter__, NOARGS),
+    METHOD(exit, __exit__, VARARGS),
+    {NULL},
+};
+
+#undef METHOD
+
+DOCSTRING(Batch,
+          "Batch()\n\n"
+          "A sequence of Emacs function calls that are executed together. "
+          "Use :func:`batch` to create one. When used as a context manager, the batch "
+          "runs when the block exits normally.\n\n"
+          ".. code:: python\n\n"
+          "   with emacs_raw.batch() as b:\n"
+          "       rest = b.call(cdr, cell)\n"
+          "       b.call(setcar, rest, value)\n"
+          "   rest.value  # => the cdr of cell")
+
+PyTypeObject BatchType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "emacs_raw.Batch",                // tp_name
+    sizeof(Batch),                    // tp_basicsize
+    0,                                // tp_itemsize
+    (destructor)Batch_dealloc,        // tp_dealloc
+    0,                                // tp_print
+    0,                                // tp_getattr
+    0,                                // tp_setattr
+    0,                                // tp_as_async
+    0,                                // tp_repr
+    0,                                // tp_as_number
+    0,                                // tp_as_sequence
+    0,                                // tp_as_mapping
+    0,                                // tp_hash
+    0,                                // tp_call
+    0,                                // tp_str
+    0,                                // tp_getattro
+    0,                                // tp_setattro
+    0,                                // tp_as_buffer
+    Py_TPFLAGS_DEFAULT,               // tp_flags
+    __doc_Batch,                      // tp_doc
+    0,                                // tp_traverse
+    0,                                // tp_clear
+    0,                                // tp_richcompare
+    0,                                // tp_weaklistoffset
+    0,                                // tp_iter
+    0,                                // tp_internext
+    Batch_methods,                    // tp_methods
+    0,                                // tp_members
+    0,                                // tp_getset
+    0,                                // tp_base
+    0,                                // tp_dict
+    0,                                // tp_descr_get
+    0,                                // tp_descr_set
+    0,                                // tp_dictoffset
+    0,                                // tp_init
+    0,                                // tp_alloc
+    0,                                // tp_new
+    0,                                // tp_free
+    0,                                // tp_is_gc
+    0,                                // tp_bases
+    0,                                // tp_mro
+    0,                                // tp_cache
+    0,                                // tp_subclasses
+    0,                                // tp_weaklist
+    0,                                // tp_del
+    0,                                // tp_version_tag
+    0,                                // tp_finalize
+};
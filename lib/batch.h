@@ -0,0 +1,40 @@
+#include <Python.h>
+
+#include "util.h"
+
+#ifndef BATCH_H
+#define BATCH_H
+
+
+/**
+ * \brief A recorded sequence of Emacs function calls.
+ *
+ * Calls are recorded from Python and executed in one go, with a single error
+ * check at the end. The arguments of a call may refer to the results of
+ * earlier calls.
+ */
+typedef struct {
+    PyObject_HEAD
+    PyObject *calls;
+    size_t serial;
+} Batch;
+
+/**
+ * \brief The result of a call in a batch.
+ */
+typedef struct {
+    PyObject_HEAD
+    size_t batch;
+    Py_ssize_t index;
+    Py_ssize_t uses;
+    PyObject *value;
+} BatchResult;
+
+PyTypeObject BatchType;
+PyTypeObject BatchResultType;
+
+EXTERN_DOCSTRING(py_batch)
+PyObject *py_batch(PyObject *self, PyObject *args);
+
+
+#endif /* BATCH_H */
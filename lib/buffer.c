@@ -0,0 +1,295 @@
+#include <Python.h>
+#include <ctype.h>
+
+#include "emacs-interface.h"
+#include "error.h"
+#include "object.h"
+
+#include "buffer.h"
+
+
+
+// Spans
+//
+// Spans are read either from a sequence of tuples or from a flat buffer of
+// integers, and properties are converted once per distinct Python object, so
+// that the common case of many spans sharing a few property dicts stays cheap.
+
+typedef struct {
+    PyObject *seq;              // Sequence of tuples, or NULL
+    Py_buffer view;             // Flat buffer of integers, if seq is NULL
+    Py_ssize_t size;            // Number of spans
+    PyObject *last_props;       // Properties converted most recently
+    emacs_value last_eprops;    // ... as a plist
+    emacs_value *last_array;    // ... as an array of keys and values
+    Py_ssize_t last_count;      // Number of elements in last_array
+} Spans;
+
+static bool Spans__init(Spans *self, PyObject *spans)
+{
+    self->seq = NULL;
+    self->last_props = NULL;
+    self->last_array = NULL;
+    self->last_count = 0;
+
+    if (PyObject_CheckBuffer(spans)) {
+        if (PyObject_GetBuffer(spans, &self->view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0)
+            return false;
+        const char *format = self->view.format ? self->view.format : "B";
+        if (format[0] == '@' || format[0] == '=')
+            format++;
+        if (strlen(format) != 1 || !strchr("qlihQLIH", format[0]) || self->view.ndim > 1
+            || (self->view.itemsize != 8 && self->view.itemsize != 4 && self->view.itemsize != 2))
+        {
+            PyBuffer_Release(&self->view);
+            PyErr_SetString(PyExc_TypeError, "Expected a buffer of integers");
+            return false;
+        }
+        Py_ssize_t count = self->view.len / self->view.itemsize;
+        if (count % 2) {
+            PyBuffer_Release(&self->view);
+            PyErr_SetString(PyExc_ValueError, "Expected an even number of positions");
+            return false;
+        }
+        self->size = count / 2;
+        return true;
+    }
+
+    if (!(self->seq = PySequence_Fast(spans, "Expected a sequence or a buffer of integers")))
+        return false;
+    self->size = PySequence_Fast_GET_SIZE(self->seq);
+    return true;
+}
+
+static void Spans__release(Spans *self)
+{
+    free(self->last_array);
+    if (self->seq)
+        Py_DECREF(self->seq);
+    else
+        PyBuffer_Release(&self->view);
+}
+
+static intmax_t Spans__position(Spans *self, Py_ssize_t i)
+{
+    const char *p = (const char *)self->view.buf + i * self->view.itemsize;
+    bool is_unsigned = isupper((unsigned char)self->view.format[strlen(self->view.format) - 1]);
+    switch (self->view.itemsize) {
+    case 8: return is_unsigned ? (intmax_t)*(const uint64_t *)p : *(const int64_t *)p;
+    case 4: return is_unsigned ? (intmax_t)*(const uint32_t *)p : *(const int32_t *)p;
+    case 2: return is_unsigned ? (intmax_t)*(const uint16_t *)p : *(const int16_t *)p;
+    default: return 0;
+    }
+}
+
+// Convert properties given as a dict or an Emacs plist, both to a plist and
+// to an array of alternating keys and values
+static bool Spans__convert_props(Spans *self, PyObject *props)
+{
+    free(self->last_array);
+    self->last_array = NULL;
+    self->last_count = 0;
+    self->last_props = NULL;
+
+    if (PyObject_TypeCheck(props, &EmacsObjectType)) {
+        emacs_value plist = ((EmacsObject *)props)->val;
+        Py_ssize_t size = 0, capacity = 8;
+        emacs_value *array = (emacs_value *)malloc(capacity * sizeof(emacs_value));
+        for (emacs_value cell = plist; em_consp(cell); cell = em_funcall_1(em__cdr, cell)) {
+            if (size == capacity)
+                array = (emacs_value *)realloc(array, (capacity *= 2) * sizeof(emacs_value));
+            array[size++] = em_funcall_1(em__car, cell);
+        }
+        if (propagate_emacs_error()) {
+            free(array);
+            return false;
+        }
+        self->last_eprops = plist;
+        self->last_array = array;
+        self->last_count = size - size % 2;
+    }
+    else if (PyDict_Check(props)) {
+        Py_ssize_t size = PyDict_Size(props), ppos = 0, i = 0;
+        emacs_value *array = (emacs_value *)malloc((2 * size + 1) * sizeof(emacs_value));
+        PyObject *key, *value;
+        bool success = true;
+        while (success && PyDict_Next(props, &ppos, &key, &value)) {
+            success = EmacsObject__convert(key, CONVERT_SYMBOL, &array[i++])
+                && EmacsObject__convert(value, 0, &array[i++]);
+        }
+        if (!success) {
+            free(array);
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_TypeError, "Unable to convert property value");
+            return false;
+        }
+        self->last_eprops = em_funcall(em__list, Py_SAFE_DOWNCAST(2 * size, Py_ssize_t, int), array);
+        self->last_array = array;
+        self->last_count = 2 * size;
+    }
+    else {
+        PyErr_SetString(PyExc_TypeError, "Properties must be a dict or an Emacs plist");
+        return false;
+    }
+
+    self->last_props = props;
+    return true;
+}
+
+// Get the bounds and properties of a span
+static bool Spans__get(Spans *self, Py_ssize_t i, PyObject *default_props,
+                       emacs_value *start, emacs_value *end, emacs_value *eprops)
+{
+    PyObject *props = default_props;
+
+    if (!self->seq) {
+        *start = em_int(Spans__position(self, 2 * i));
+        *end = em_int(Spans__position(self, 2 * i + 1));
+    }
+    else {
+        PyObject *span = PySequence_Fast_ITEMS(self->seq)[i];
+        if (!PyTuple_Check(span) || PyTuple_GET_SIZE(span) < 2 || PyTuple_GET_SIZE(span) > 3) {
+            PyErr_SetString(PyExc_TypeError, "Spans must be tuples (start, end[, props])");
+            return false;
+        }
+        if (!EmacsObject__coerce(PyTuple_GET_ITEM(span, 0), false, start)
+            || !EmacsObject__coerce(PyTuple_GET_ITEM(span, 1), false, end))
+        {
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_TypeError, "Invalid span position");
+            return false;
+        }
+        if (PyTuple_GET_SIZE(span) == 3)
+            props = PyTuple_GET_ITEM(span, 2);
+    }
+
+    if (!props || props == Py_None) {
+        free(self->last_array);
+        self->last_array = NULL;
+        self->last_count = 0;
+        self->last_props = NULL;
+        *eprops = em__nil;
+        return true;
+    }
+    if (props != self->last_props && !Spans__convert_props(self, props))
+        return false;
+    *eprops = self->last_eprops;
+    return true;
+}
+
+
+
+// Bulk operations
+
+// A buffer, a buffer name, or None for the current buffer
+static bool resolve_buffer(PyObject *buffer, emacs_value *ret)
+{
+    if (!EmacsObject__coerce(buffer, false, ret)) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_TypeError, "Invalid buffer");
+        return false;
+    }
+    if (!em_stringp(*ret))
+        return !propagate_emacs_error();
+
+    emacs_value name = *ret;
+    *ret = em_funcall_1(em__get_buffer, name);
+    if (propagate_emacs_error())
+        return false;
+    if (!em_truthy(*ret)) {
+        PyObject *pyname = EmacsObject__pystring(name);
+        if (pyname) {
+            PyErr_Format(PyExc_ValueError, "No buffer named %U", pyname);
+            Py_DECREF(pyname);
+        }
+        return false;
+    }
+    return true;
+}
+
+PUBLIC_DOCSTRING(py_add_text_properties,
+                 "add_text_properties(spans, props=None, buffer=None)\n\n"
+                 "Adds text properties to many regions of a buffer in one call, using "
+                 ":lisp:`add-text-properties`.\n\n"
+                 "The spans are either a sequence of tuples :code:`(start, end)` or "
+                 ":code:`(start, end, props)`, or a flat buffer of integers such as "
+                 ":code:`array('q', [start, end, start, end, ...])`. Properties given in a tuple "
+                 "take precedence over `props`.\n\n"
+                 "Properties are a dict or an Emacs property list. Dict keys become symbols, and "
+                 "values are converted as by :func:`convert`. Use :func:`intern` for values "
+                 "that must be symbols, such as faces.\n\n"
+                 "The buffer defaults to the current buffer. Returns the number of spans.")
+PyObject *py_add_text_properties(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    UNUSED(self);
+    PyObject *spans, *props = NULL, *buffer = Py_None;
+    char *keywords[] = {"spans", "props", "buffer", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OO", keywords, &spans, &props, &buffer))
+        return NULL;
+
+    emacs_value ebuffer;
+    if (!resolve_buffer(buffer, &ebuffer))
+        return NULL;
+
+    Spans s;
+    if (!Spans__init(&s, spans))
+        return NULL;
+
+    // Errors in Emacs make the remaining calls return immediately, so they
+    // are checked once at the end, before any later error in Python
+    bool success = true;
+    emacs_value argv[4] = {NULL, NULL, NULL, ebuffer};
+    for (Py_ssize_t i = 0; i < s.size && success; i++) {
+        success = Spans__get(&s, i, props, &argv[0], &argv[1], &argv[2]);
+        if (success)
+            em_funcall(em__add_text_properties, 4, argv);
+    }
+
+    Py_ssize_t size = s.size;
+    Spans__release(&s);
+    if (propagate_emacs_error() || !success)
+        return NULL;
+    return PyLong_FromSsize_t(size);
+}
+
+PUBLIC_DOCSTRING(py_make_overlays,
+                 "make_overlays(spans, props=None, buffer=None)\n\n"
+                 "Creates an overlay for each of many regions of a buffer in one call, and sets "
+                 "their properties. The arguments are as for :func:`add_text_properties`.\n\n"
+                 "Returns an Emacs list of the new overlays.")
+PyObject *py_make_overlays(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    UNUSED(self);
+    PyObject *spans, *props = NULL, *buffer = Py_None;
+    char *keywords[] = {"spans", "props", "buffer", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OO", keywords, &spans, &props, &buffer))
+        return NULL;
+
+    emacs_value ebuffer;
+    if (!resolve_buffer(buffer, &ebuffer))
+        return NULL;
+
+    Spans s;
+    if (!Spans__init(&s, spans))
+        return NULL;
+
+    // Build the list of overlays back to front. As above, errors in Emacs
+    // are checked at the end.
+    bool success = true;
+    emacs_value ret = em__nil;
+    for (Py_ssize_t i = s.size - 1; i >= 0 && success; i--) {
+        emacs_value start, end, eprops;
+        if (!(success = Spans__get(&s, i, props, &start, &end, &eprops)))
+            break;
+
+        emacs_value overlay = em_funcall_3(em__make_overlay, start, end, ebuffer);
+        for (Py_ssize_t j = 0; j < s.last_count; j += 2)
+            em_funcall_3(em__overlay_put, overlay, s.last_array[j], s.last_array[j + 1]);
+        ret = em_cons(overlay, ret);
+    }
+
+    Spans__release(&s);
+    if (propagate_emacs_error() || !success)
+        return NULL;
+    return EmacsObject__make(&EmacsObjectType, ret);
+}
@@ -0,0 +1,16 @@
+#include <Python.h>
+
+#include "util.h"
+
+#ifndef BUFFER_H
+#define BUFFER_H
+
+
+EXTERN_DOCSTRING(py_add_text_properties)
+PyObject *py_add_text_properties(PyObject *self, PyObject *args, PyObject *kwds);
+
+EXTERN_DOCSTRING(py_make_overlays)
+PyObject *py_make_overlays(PyObject *self, PyObject *args, PyObject *kwds);
+
+
+#endif /* BUFFER_H */
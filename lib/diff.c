@@ -0,0 +1,227 @@
+#include <Python.h>
+#include <stdbool.h>
+
+#include "diff.h"
+
+
+
+// Line diff
+//
+// A plain Myers diff over lines, after trimming the common prefix and suffix.
+// Lines are compared by hash first, so most comparisons don't look at the
+// text. The furthest reaching x on each diagonal is kept for every cost d, so
+// that the path can be traced back without a second pass.
+
+typedef struct {
+    PyObject **lines;
+    Py_hash_t *hashes;
+} Lines;
+
+static bool Lines__init(Lines *self, PyObject *list, Py_ssize_t start, Py_ssize_t len)
+{
+    self->lines = &PySequence_Fast_ITEMS(list)[start];
+    self->hashes = (Py_hash_t *)malloc((len > 0 ? len : 1) * sizeof(Py_hash_t));
+    for (Py_ssize_t i = 0; i < len; i++)
+        if ((self->hashes[i] = PyObject_Hash(self->lines[i])) == -1)
+            return false;
+    return true;
+}
+
+static inline bool Lines__eq(Lines *a, Py_ssize_t i, Lines *b, Py_ssize_t j)
+{
+    return a->hashes[i] == b->hashes[j] &&
+        PyObject_RichCompareBool(a->lines[i], b->lines[j], Py_EQ) == 1;
+}
+
+// A hunk replacing old lines [x0, x1) by new lines [y0, y1)
+typedef struct {
+    Py_ssize_t x0, x1, y0, y1;
+} Hunk;
+
+// Compute hunks in reverse order. Returns the number of hunks, or -1 if the
+// cost exceeds max_cost.
+static Py_ssize_t myers(Lines *a, Py_ssize_t n, Lines *b, Py_ssize_t m,
+                        Py_ssize_t max_cost, Hunk *hunks)
+{
+    Py_ssize_t max_d = n + m < max_cost ? n + m : max_cost;
+    Py_ssize_t **trace = (Py_ssize_t **)calloc(max_d + 1, sizeof(Py_ssize_t *));
+    Py_ssize_t d, found = -1;
+
+    // trace[d][k + d] is the furthest x on diagonal k = x - y with cost d
+    for (d = 0; d <= max_d && found < 0; d++) {
+        Py_ssize_t *cur = trace[d] = (Py_ssize_t *)malloc((2 * d + 1) * sizeof(Py_ssize_t));
+        Py_ssize_t *prev = d > 0 ? trace[d - 1] : NULL;
+
+        for (Py_ssize_t k = -d; k <= d; k += 2) {
+            Py_ssize_t x;
+            if (d == 0)
+                x = 0;
+            else if (k == -d || (k != d && prev[k - 1 + d - 1] < prev[k + 1 + d - 1]))
+                x = prev[k + 1 + d - 1];
+            else
+                x = prev[k - 1 + d - 1] + 1;
+
+            Py_ssize_t y = x - k;
+            while (x < n && y < m && Lines__eq(a, x, b, y))
+                x++, y++;
+            cur[k + d] = x;
+
+            if (x >= n && y >= m) {
+                found = d;
+                break;
+            }
+        }
+    }
+
+    Py_ssize_t nhunks = -1;
+    if (found >= 0) {
+        nhunks = 0;
+        Py_ssize_t x = n, y = m;
+        Hunk *hunk = NULL;
+
+        for (d = found; d > 0; d--) {
+            Py_ssize_t *prev = trace[d - 1];
+            Py_ssize_t k = x - y, pk;
+            if (k == -d || (k != d && prev[k - 1 + d - 1] < prev[k + 1 + d - 1]))
+                pk = k + 1;
+            else
+                pk = k - 1;
+
+            Py_ssize_t px = prev[pk + d - 1], py = px - pk;
+            bool insert = pk == k + 1;
+            Py_ssize_t ex = px + (insert ? 0 : 1), ey = py + (insert ? 1 : 0);
+
+            // Extend the current hunk if there is no snake in between
+            if (hunk && hunk->x0 == ex && hunk->y0 == ey) {
+                hunk->x0 = px;
+                hunk->y0 = py;
+            }
+            else {
+                hunk = &hunks[nhunks++];
+                hunk->x0 = px;
+                hunk->x1 = ex;
+                hunk->y0 = py;
+                hunk->y1 = ey;
+            }
+
+            x = px;
+            y = py;
+        }
+    }
+
+    for (d = 0; d <= max_d; d++)
+        free(trace[d]);
+    free(trace);
+    return nhunks;
+}
+
+static PyObject *make_edit(PyObject *new_lines, Py_ssize_t *offsets, Py_ssize_t prefix, Hunk *hunk)
+{
+    PyObject *slice = PySequence_GetSlice(new_lines, prefix + hunk->y0, prefix + hunk->y1);
+    if (!slice)
+        return NULL;
+    PyObject *empty = PyUnicode_FromString("");
+    PyObject *text = empty ? PyUnicode_Join(empty, slice) : NULL;
+    Py_XDECREF(empty);
+    Py_DECREF(slice);
+    if (!text)
+        return NULL;
+    return Py_BuildValue("nnN", offsets[prefix + hunk->x0], offsets[prefix + hunk->x1], text);
+}
+
+PUBLIC_DOCSTRING(py_diff,
+                 "diff(old, new, max_cost=1024)\n\n"
+                 "Computes a line-based edit script that turns the string `old` into `new`, "
+                 "using the Myers algorithm.\n\n"
+                 "Returns a list of tuples :code:`(start, end, text)`, meaning that the characters "
+                 "from `start` to `end` in `old` (zero-based, end exclusive) are replaced by `text`. "
+                 "The edits are ordered from the end of the string to the beginning, so they can be "
+                 "applied in order without adjusting the offsets.\n\n"
+                 "If more than `max_cost` lines must be inserted or deleted, the changed region "
+                 "is replaced as a whole instead.")
+PyObject *py_diff(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    UNUSED(self);
+    PyObject *old, *new;
+    Py_ssize_t max_cost = 1024;
+    char *keywords[] = {"old", "new", "max_cost", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "UU|n", keywords, &old, &new, &max_cost))
+        return NULL;
+    if (max_cost < 0) {
+        PyErr_SetString(PyExc_ValueError, "max_cost must not be negative");
+        return NULL;
+    }
+
+    PyObject *old_lines = PyUnicode_Splitlines(old, 1);
+    PyObject *new_lines = old_lines ? PyUnicode_Splitlines(new, 1) : NULL;
+    if (!new_lines) {
+        Py_XDECREF(old_lines);
+        return NULL;
+    }
+
+    Py_ssize_t n = PyList_GET_SIZE(old_lines), m = PyList_GET_SIZE(new_lines);
+    PyObject **a = PySequence_Fast_ITEMS(old_lines), **b = PySequence_Fast_ITEMS(new_lines);
+
+    // Character offsets of the old lines
+    Py_ssize_t *offsets = (Py_ssize_t *)malloc((n + 1) * sizeof(Py_ssize_t));
+    offsets[0] = 0;
+    for (Py_ssize_t i = 0; i < n; i++)
+        offsets[i + 1] = offsets[i] + PyUnicode_GET_LENGTH(a[i]);
+
+    // Trim the common prefix and suffix
+    Py_ssize_t prefix = 0, suffix = 0;
+    while (prefix < n && prefix < m && PyObject_RichCompareBool(a[prefix], b[prefix], Py_EQ) == 1)
+        prefix++;
+    while (suffix < n - prefix && suffix < m - prefix &&
+           PyObject_RichCompareBool(a[n - suffix - 1], b[m - suffix - 1], Py_EQ) == 1)
+        suffix++;
+    n -= prefix + suffix;
+    m -= prefix + suffix;
+
+    PyObject *ret = NULL;
+    Lines la = {NULL, NULL}, lb = {NULL, NULL};
+    Hunk *hunks = NULL;
+    Py_ssize_t nhunks = 0;
+
+    if (PyErr_Occurred())
+        goto done;
+
+    if (n > 0 && m > 0) {
+        if (!Lines__init(&la, old_lines, prefix, n) || !Lines__init(&lb, new_lines, prefix, m))
+            goto done;
+        hunks = (Hunk *)malloc((n < m ? n + 1 : m + 1) * sizeof(Hunk));
+        nhunks = myers(&la, n, &lb, m, max_cost, hunks);
+        if (PyErr_Occurred())
+            goto done;
+    }
+    else if (n > 0 || m > 0)
+        nhunks = -1;
+
+    // Replace the whole changed region if there is no cheap edit script
+    if (nhunks < 0) {
+        free(hunks);
+        hunks = (Hunk *)malloc(sizeof(Hunk));
+        hunks[0] = (Hunk){0, n, 0, m};
+        nhunks = 1;
+    }
+
+    if (!(ret = PyList_New(nhunks)))
+        goto done;
+    for (Py_ssize_t i = 0; i < nhunks; i++) {
+        PyObject *edit = make_edit(new_lines, offsets, prefix, &hunks[i]);
+        if (!edit) {
+            Py_CLEAR(ret);
+            goto done;
+        }
+        PyList_SET_ITEM(ret, i, edit);
+    }
+
+done:
+    free(la.hashes);
+    free(lb.hashes);
+    free(hunks);
+    free(offsets);
+    Py_DECREF(old_lines);
+    Py_DECREF(new_lines);
+    return ret;
+}
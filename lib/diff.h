@@ -0,0 +1,13 @@
+#include <Python.h>
+
+#include "util.h"
+
+#ifndef DIFF_H
+#define DIFF_H
+
+
+EXTERN_DOCSTRING(py_diff)
+PyObject *py_diff(PyObject *self, PyObject *args, PyObject *kwds);
+
+
+#endif /* DIFF_H */
@@ -7,6 +7,10 @@
 
 #include "emacs-interface.h"
 
+// Whether the running Emacs provides a given environment function
+#define ENV_HAS(env, field) \
+    ((size_t)(env)->size >= offsetof(emacs_env, field) + sizeof((env)->field))
+
 
 
 // Populate internal objects
@@ -30,6 +34,7 @@ void populate()
     SIMPLE_POPULATE(cdr);
     SIMPLE_POPULATE(length);
     SIMPLE_POPULATE(aref);
+    SIMPLE_POPULATE(aset);
     SIMPLE_POPULATE(arrayp);
     SIMPLE_POPULATE(format);
     SIMPLE_POPULATE(list);
@@ -45,11 +50,43 @@ void populate()
     SIMPLE_POPULATE(eq);
     SIMPLE_POPULATE(eql);
     SIMPLE_POPULATE(equal);
+    SIMPLE_POPULATE(puthash);
+    SIMPLE_POPULATE(integer);
+    SIMPLE_POPULATE(float);
+    SIMPLE_POPULATE(string);
+    SIMPLE_POPULATE(symbol);
+    SIMPLE_POPULATE(floor);
+    SIMPLE_POPULATE(mod);
+    SIMPLE_POPULATE(ash);
+    SIMPLE_POPULATE(expt);
+    SIMPLE_POPULATE(abs);
+    SIMPLE_POPULATE(lognot);
+    SIMPLE_POPULATE(defalias);
 
     POPULATE(symbol_value, "symbol-value");
     POPULATE(number_or_marker_p, "number-or-marker-p");
     POPULATE(symbol_name, "symbol-name");
     POPULATE(type_of, "type-of");
+    POPULATE(make_hash_table, "make-hash-table");
+    POPULATE(kw_test, ":test");
+    POPULATE(kw_size, ":size");
+    POPULATE(user_ptr, "user-ptr");
+    POPULATE(python_error, "tripoli-python-error");
+    POPULATE(read_from_string, "read-from-string");
+    POPULATE(byte_compile, "byte-compile");
+    POPULATE(add_text_properties, "add-text-properties");
+    POPULATE(make_overlay, "make-overlay");
+    POPULATE(get_buffer, "get-buffer");
+    POPULATE(make_vector, "make-vector");
+    POPULATE(overlay_put, "overlay-put");
+    POPULATE(sxhash_eq, "sxhash-eq");
+    POPULATE(sxhash_equal, "sxhash-equal");
+    POPULATE(intern_soft, "intern-soft");
+    POPULATE(symbols_consed, "symbols-consed");
+    POPULATE(add, "+");
+    POPULATE(subtract, "-");
+    POPULATE(multiply, "*");
+    POPULATE(divide, "/");
     POPULATE(equal_sign, "=");
     POPULATE(string_equal, "string-equal");
     POPULATE(lt, "<");
@@ -58,6 +95,8 @@ void populate()
     POPULATE(ge, ">=");
     POPULATE(string_lt, "string<");
     POPULATE(string_gt, "string>");
+
+    em__print_format = em_make_global(em_str("%S"));
 }
 
 #undef SIMPLE_POPULATE
@@ -69,12 +108,15 @@ void populate()
 
 static EnvCons *__env_stack = NULL;
 
+static void run_deferred();
+
 void push_env(emacs_env *env)
 {
     EnvCons *new_cons = (EnvCons *)malloc(sizeof(EnvCons));
     new_cons->env = env;
     new_cons->next = __env_stack;
     __env_stack = new_cons;
+    run_deferred();
 }
 
 emacs_env *get_env()
@@ -94,21 +136,77 @@ emacs_env *pop_env()
 }
 
 
+
+// Deferred finalizers
+//
+// Finalizers of user pointers run during garbage collection, when no
+// environment is valid. Those that need one queue their work here instead, and
+// it runs as soon as the next environment is pushed.
+
+typedef struct {
+    em_finalizer fin;
+    void *ptr;
+} Deferred;
+
+static Deferred *__deferred = NULL;
+static size_t __num_deferred = 0, __max_deferred = 0;
+static bool __running_deferred = false;
+
+void em_defer(em_finalizer fin, void *ptr)
+{
+    if (__num_deferred == __max_deferred) {
+        size_t max = __max_deferred ? 2 * __max_deferred : 64;
+        Deferred *deferred = (Deferred *)realloc(__deferred, max * sizeof(Deferred));
+        if (!deferred)
+            return;     // Leak rather than crash during garbage collection
+        __deferred = deferred;
+        __max_deferred = max;
+    }
+    __deferred[__num_deferred].fin = fin;
+    __deferred[__num_deferred].ptr = ptr;
+    __num_deferred++;
+}
+
+static void run_deferred()
+{
+    // Finalizers may push environments themselves, and may queue more work
+    if (__running_deferred)
+        return;
+    __running_deferred = true;
+    while (__num_deferred > 0) {
+        Deferred d = __deferred[--__num_deferred];
+        d.fin(d.ptr);
+    }
+    __running_deferred = false;
+}
+
+
 
 // Global references
 
+static size_t __live_globals = 0, __total_globals = 0;
+
 emacs_value em_make_global(emacs_value val)
 {
     emacs_env *env = get_env();
+    __live_globals++;
+    __total_globals++;
     return env->make_global_ref(env, val);
 }
 
 void em_free_global(emacs_value val)
 {
     emacs_env *env = get_env();
+    __live_globals--;
     env->free_global_ref(env, val);
 }
 
+void em_global_stats(size_t *live, size_t *total)
+{
+    *live = __live_globals;
+    *total = __total_globals;
+}
+
 
 
 // Basic Emacs types
@@ -125,6 +223,23 @@ emacs_value em_str(const char *str)
     return env->make_string(env, str, strlen(str));
 }
 
+emacs_value em_strn(const char *str, ptrdiff_t len)
+{
+    emacs_env *env = get_env();
+    return env->make_string(env, str, len);
+}
+
+emacs_value em_ascii_strn(const char *str, ptrdiff_t len)
+{
+    emacs_env *env = get_env();
+#if defined(EMACS_MAJOR_VERSION) && EMACS_MAJOR_VERSION >= 28
+    // Unibyte strings skip decoding, and are equivalent for ASCII text
+    if (ENV_HAS(env, make_unibyte_string))
+        return env->make_unibyte_string(env, str, len);
+#endif
+    return env->make_string(env, str, len);
+}
+
 emacs_value em_int(intmax_t val)
 {
     emacs_env *env = get_env();
@@ -149,12 +264,74 @@ emacs_value em_cons(emacs_value car, emacs_value cdr)
     return em_funcall_2(em__cons, car, cdr);
 }
 
+emacs_value em_make_vector(ptrdiff_t size, emacs_value init)
+{
+    return em_funcall_2(em__make_vector, em_int(size), init);
+}
+
+emacs_value em_vec_get(emacs_value vec, ptrdiff_t i)
+{
+    emacs_env *env = get_env();
+    return env->vec_get(env, vec, i);
+}
+
+void em_vec_set(emacs_value vec, ptrdiff_t i, emacs_value val)
+{
+    emacs_env *env = get_env();
+    env->vec_set(env, vec, i, val);
+}
+
+ptrdiff_t em_vec_size(emacs_value vec)
+{
+    emacs_env *env = get_env();
+    return env->vec_size(env, vec);
+}
+
+emacs_value em_user_ptr(em_finalizer fin, void *ptr)
+{
+    emacs_env *env = get_env();
+    return env->make_user_ptr(env, fin, ptr);
+}
+
+void *em_get_user_ptr(emacs_value val, em_finalizer *fin)
+{
+    emacs_env *env = get_env();
+    if (fin)
+        *fin = env->get_user_finalizer(env, val);
+    return env->get_user_ptr(env, val);
+}
+
 char *em_symbol_name(emacs_value val)
 {
     emacs_value name = em_funcall_1(em__symbol_name, val);
     return em_extract_str(name);
 }
 
+char *em_extract_strn(emacs_value val, ptrdiff_t *len)
+{
+    emacs_env *env = get_env();
+    ptrdiff_t size;
+    env->copy_string_contents(env, val, NULL, &size);
+    char *buffer = (char *)malloc(size * sizeof(char));
+    env->copy_string_contents(env, val, buffer, &size);
+    *len = size - 1;
+    return buffer;
+}
+
+ptrdiff_t em_strn_size(emacs_value val)
+{
+    emacs_env *env = get_env();
+    ptrdiff_t size = 0;
+    env->copy_string_contents(env, val, NULL, &size);
+    return size - 1;
+}
+
+bool em_copy_strn(emacs_value val, char *buffer, ptrdiff_t size)
+{
+    emacs_env *env = get_env();
+    return env->copy_string_contents(env, val, buffer, &size);
+}
+
 char *em_extract_str(emacs_value val)
 {
     emacs_env *env = get_env();
@@ -171,6 +348,34 @@ intmax_t em_extract_int(emacs_value val)
     return env->extract_integer(env, val);
 }
 
+bool em_extract_int_exact(emacs_value val, intmax_t *out)
+{
+    emacs_env *env = get_env();
+    *out = env->extract_integer(env, val);
+    if (env->non_local_exit_check(env) == emacs_funcall_exit_return)
+        return true;
+    env->non_local_exit_clear(env);
+    return false;
+}
+
+#if defined(EMACS_MAJOR_VERSION) && EMACS_MAJOR_VERSION >= 27
+emacs_value em_big_int(int sign, ptrdiff_t count, const emacs_limb_t *magnitude)
+{
+    emacs_env *env = get_env();
+    if (!ENV_HAS(env, make_big_integer))
+        return NULL;
+    return env->make_big_integer(env, sign, count, magnitude);
+}
+
+bool em_extract_big_int(emacs_value val, int *sign, ptrdiff_t *count, emacs_limb_t *magnitude)
+{
+    emacs_env *env = get_env();
+    if (!ENV_HAS(env, extract_big_integer))
+        return false;
+    return env->extract_big_integer(env, val, sign, count, magnitude);
+}
+#endif
+
 double em_extract_float(emacs_value val)
 {
     emacs_env *env = get_env();
@@ -193,27 +398,46 @@ bool em_truthy(emacs_value val)
         return em_truthy(em_funcall_1(em__ ## name, val));      \
     }
 
-PREDICATE(integerp)
-PREDICATE(floatp)
-PREDICATE(numberp)
+// Predicates for a single type can be answered by type-of, which, unlike
+// funcall, doesn't require a trip through the Lisp evaluator
+#define TYPE_PREDICATE(name, type)                              \
+    bool em_ ## name(emacs_value val)                           \
+    {                                                           \
+        return em_type_is(val, em__ ## type);                   \
+    }
+
+TYPE_PREDICATE(integerp, integer)
+TYPE_PREDICATE(floatp, float)
 PREDICATE(number_or_marker_p)
-PREDICATE(stringp)
-PREDICATE(symbolp)
-PREDICATE(consp)
-PREDICATE(vectorp)
+TYPE_PREDICATE(stringp, string)
+TYPE_PREDICATE(symbolp, symbol)
+TYPE_PREDICATE(consp, cons)
+TYPE_PREDICATE(vectorp, vector)
 PREDICATE(listp)
 PREDICATE(functionp)
 PREDICATE(arrayp)
 
+#undef TYPE_PREDICATE
 #undef PREDICATE
 
+bool em_numberp(emacs_value val)
+{
+    emacs_value type = em_type(val);
+    return em_eq(type, em__integer) || em_eq(type, em__float);
+}
+
+bool em_eq(emacs_value a, emacs_value b)
+{
+    emacs_env *env = get_env();
+    return env->eq(env, a, b);
+}
+
 #define COMPARE(name)                                           \
     bool em_ ## name(emacs_value a, emacs_value b)              \
     {                                                           \
         return em_truthy(em_funcall_2(em__ ## name, a, b));     \
     }
 
-COMPARE(eq)
 COMPARE(eql)
 COMPARE(equal)
 COMPARE(equal_sign)
@@ -334,22 +558,37 @@ void em_error(char *message)
 
 char *em_print_obj(emacs_value val)
 {
-    emacs_value ret = em_funcall_2(em__format, em_str("%S"), val);
+    emacs_value ret = em_funcall_2(em__format, em__print_format, val);
     return em_extract_str(ret);
 }
 
+emacs_value em_type(emacs_value val)
+{
+    emacs_env *env = get_env();
+    return env->type_of(env, val);
+}
+
 char *em_type_of(emacs_value val)
 {
-    emacs_value symbol = em_funcall_1(em__type_of, val);
-    return em_symbol_name(symbol);
+    return em_symbol_name(em_type(val));
 }
 
-bool em_type_is(emacs_value val, const char *type)
+bool em_type_is(emacs_value val, emacs_value type)
 {
-    char *actual = em_type_of(val);
-    int ret = !strcmp(actual, type);
-    free(actual);
-    return ret;
+    return em_eq(em_type(val), type);
+}
+
+emacs_value em_read(const char *source)
+{
+    return em_funcall_1(em__car, em_funcall_1(em__read_from_string, em_str(source)));
+}
+
+emacs_value em_byte_compile(emacs_value form)
+{
+    // Evaluating the form first makes it a lexical closure, so the compiled
+    // code uses lexical binding regardless of the current buffer
+    emacs_value closure = em_funcall_2(em__eval, form, em__t);
+    return em_funcall_1(em__byte_compile, closure);
 }
 
 bool em_bound_and_true_p(emacs_value val)
@@ -377,6 +616,18 @@ void em_defun(emacs_subr func, const char *name,
               bool interactive, emacs_value interactive_spec,
               const char *doc, void *data)
 {
+#if defined(EMACS_MAJOR_VERSION) && EMACS_MAJOR_VERSION >= 28
+    // Define the function directly, without evaluating a defun form
+    emacs_env *env = get_env();
+    if (ENV_HAS(env, make_interactive)) {
+        emacs_value em_func = em_function(func, min_nargs, max_nargs, doc, data);
+        if (interactive)
+            env->make_interactive(env, em_func, interactive_spec ? interactive_spec : em__nil);
+        em_funcall_2(em__defalias, em_intern(name), em_func);
+        return;
+    }
+#endif
+
     emacs_value em_func = em_function(func, min_nargs, max_nargs, NULL, data);
     emacs_value em_name = em_intern(name);
     emacs_value em_doc = doc ? em_str(doc) : NULL;
@@ -10,8 +10,16 @@
 emacs_value em__nil, em__t, em__error, em__eval, em__boundp, em__symbol_value,
     em__quote;
 emacs_value em__cons, em__setcar, em__setcdr, em__vector, em__car, em__cdr;
-emacs_value em__length, em__aref, em__arrayp;
+emacs_value em__length, em__aref, em__aset, em__arrayp;
 emacs_value em__format, em__list, em__symbol_name, em__type_of;
+emacs_value em__make_hash_table, em__puthash, em__kw_test, em__kw_size;
+emacs_value em__integer, em__float, em__string, em__symbol, em__print_format;
+emacs_value em__user_ptr, em__python_error, em__read_from_string, em__byte_compile;
+emacs_value em__add, em__subtract, em__multiply, em__divide, em__floor, em__mod,
+    em__ash, em__expt, em__abs, em__lognot;
+emacs_value em__add_text_properties, em__make_overlay, em__overlay_put, em__get_buffer,
+    em__make_vector, em__sxhash_eq, em__sxhash_equal, em__defalias;
+emacs_value em__intern_soft, em__symbols_consed;
 emacs_value em__integerp, em__floatp, em__numberp, em__stringp, em__symbolp,
     em__consp, em__vectorp, em__listp, em__functionp, em__number_or_marker_p;
 emacs_value em__eq, em__eql, em__equal, em__equal_sign, em__string_equal,
@@ -85,10 +93,22 @@ emacs_value em_make_global(emacs_value val);
  */
 void em_free_global(emacs_value val);
 
+/**
+ * \brief Get global reference statistics.
+ * \param live Number of global references currently held.
+ * \param total Number of global references created so far.
+ */
+void em_global_stats(size_t *live, size_t *total);
+
 
 
 // Basic Emacs types
 
+/**
+ * \brief Finalizer for user pointers.
+ */
+typedef void (*em_finalizer)(void *);
+
 /**
  * \brief Create an interned symbol.
  */
@@ -100,6 +120,20 @@ emacs_value em_intern(const char *name);
  */
 emacs_value em_str(const char *str);
 
+/**
+ * \brief Create a string from UTF-8 data of a given length.
+ * \param str UTF-8 encoded data, which may contain NULs (caller keeps ownership).
+ * \param len Length in bytes.
+ */
+emacs_value em_strn(const char *str, ptrdiff_t len);
+
+/**
+ * \brief Create a string from ASCII data of a given length.
+ *
+ * On Emacs 28 and later this creates a unibyte string without decoding.
+ */
+emacs_value em_ascii_strn(const char *str, ptrdiff_t len);
+
 /**
  * \brief Create an integer.
  */
@@ -126,6 +160,52 @@ emacs_value em_function(emacs_subr func, ptrdiff_t min_nargs, ptrdiff_t max_narg
  */
 emacs_value em_cons(emacs_value car, emacs_value cdr);
 
+/**
+ * \brief Create a vector.
+ * \param size Number of elements.
+ * \param init Initial value of every element.
+ */
+emacs_value em_make_vector(ptrdiff_t size, emacs_value init);
+
+/**
+ * \brief Get an element of a vector, using the module API.
+ */
+emacs_value em_vec_get(emacs_value vec, ptrdiff_t i);
+
+/**
+ * \brief Set an element of a vector, using the module API.
+ */
+void em_vec_set(emacs_value vec, ptrdiff_t i, emacs_value val);
+
+/**
+ * \brief Get the size of a vector, using the module API.
+ */
+ptrdiff_t em_vec_size(emacs_value vec);
+
+/**
+ * \brief Create a user pointer.
+ * \param fin Finalizer, called with the pointer when the object is collected.
+ * \param ptr The pointer to wrap.
+ */
+emacs_value em_user_ptr(em_finalizer fin, void *ptr);
+
+/**
+ * \brief Extract a user pointer.
+ * \param val An Emacs object (must be a user pointer).
+ * \param fin If not NULL, the finalizer of the user pointer is stored here.
+ */
+void *em_get_user_ptr(emacs_value val, em_finalizer *fin);
+
+/**
+ * \brief Run a finalizer once an environment is available.
+ *
+ * User pointer finalizers run during garbage collection, where no em_ function
+ * may be called. Finalizers that need to (including any that may release
+ * Python objects) should call this instead, and the work is done the next time
+ * an environment is pushed.
+ */
+void em_defer(em_finalizer fin, void *ptr);
+
 /**
  * \brief Extract a symbol name.
  * \param val An Emacs object (must be a symbol).
@@ -140,12 +220,69 @@ char *em_symbol_name(emacs_value val);
  */
 char *em_extract_str(emacs_value val);
 
+/**
+ * \brief Extract a string that may contain NULs.
+ * \param val An Emacs object (must be a string).
+ * \param len Set to the length in bytes, excluding the terminating NUL.
+ * \return UTF-8 encoded string contents (caller receives ownership).
+ */
+char *em_extract_strn(emacs_value val, ptrdiff_t *len);
+
+/**
+ * \brief Get the length of a string in bytes, when UTF-8 encoded.
+ * \param val An Emacs object (must be a string).
+ */
+ptrdiff_t em_strn_size(emacs_value val);
+
+/**
+ * \brief Copy the UTF-8 encoded contents of a string into a buffer.
+ * \param val An Emacs object (must be a string).
+ * \param buffer Receives the contents and a terminating NUL.
+ * \param size The size of the buffer, at least em_strn_size() + 1.
+ * \return False if the buffer is too small or an error is pending.
+ */
+bool em_copy_strn(emacs_value val, char *buffer, ptrdiff_t size);
+
 /**
  * \brief Extract an integer.
  * \param val An Emacs object (must be an integer).
  */
 intmax_t em_extract_int(emacs_value val);
 
+/**
+ * \brief Extract an integer if it fits in an intmax_t.
+ * \param val An Emacs object (must be an integer).
+ * \param out Receives the value.
+ * \return False if the integer is too large, in which case no error is left
+ * pending.
+ */
+bool em_extract_int_exact(emacs_value val, intmax_t *out);
+
+#if defined(EMACS_MAJOR_VERSION) && EMACS_MAJOR_VERSION >= 27
+/**
+ * \brief Create an integer of arbitrary size.
+ * \param sign -1, 0 or 1.
+ * \param count Number of limbs in the magnitude.
+ * \param magnitude Absolute value, least significant limb first.
+ * \return The integer, or NULL if the running Emacs doesn't support bignums.
+ */
+emacs_value em_big_int(int sign, ptrdiff_t count, const emacs_limb_t *magnitude);
+
+/**
+ * \brief Extract an integer of arbitrary size.
+ *
+ * Call first with magnitude NULL to get the required count.
+ *
+ * \param val An Emacs object (must be an integer).
+ * \param sign Set to -1, 0 or 1.
+ * \param count Number of limbs available in magnitude, set to the number
+ * required.
+ * \param magnitude Receives the absolute value, least significant limb first.
+ * \return False if the running Emacs doesn't support bignums.
+ */
+bool em_extract_big_int(emacs_value val, int *sign, ptrdiff_t *count, emacs_limb_t *magnitude);
+#endif
+
 /**
  * \brief Extract a float.
  * \param val An Emacs object (must be a float).
@@ -340,6 +477,11 @@ void em_error(char *message);
 
 char *em_print_obj(emacs_value val);
 
+/**
+ * \brief Return the type of an object as a symbol.
+ */
+emacs_value em_type(emacs_value val);
+
 /**
  * \brief Return the name of the type as a string.
  * \return UTF-8 encoded type name (caller receives ownership).
@@ -349,9 +491,21 @@ char *em_type_of(emacs_value val);
 /**
  * \brief Check whether an Emacs object has a given type.
  * \param obj The Emacs object to check.
- * \param type The type to compare against.
+ * \param type The type symbol to compare against, e.g. em__string.
+ */
+bool em_type_is(emacs_value val, emacs_value type);
+
+/**
+ * \brief Read a string as a Lisp form.
+ * \param source UTF-8 encoded source code (caller keeps ownership).
+ */
+emacs_value em_read(const char *source);
+
+/**
+ * \brief Byte-compile a lambda form with lexical binding.
+ * \return A compiled function object.
  */
-bool em_type_is(emacs_value val, const char *type);
+emacs_value em_byte_compile(emacs_value form);
 
 bool em_bound_and_true_p(emacs_value val);
 void em_setcar(emacs_value cons, emacs_value car);
@@ -8,6 +8,51 @@
 #include "error.h"
 
 
+// Tracebacks are handed to Emacs as user pointers owning the exception triple
+// (type, value, traceback). They are only formatted on request.
+
+static void free_traceback(void *ptr)
+{
+    PyGILState_STATE state = PyGILState_Ensure();
+    Py_DECREF((PyObject *)ptr);
+    PyGILState_Release(state);
+}
+
+// Releasing the triple may free Emacs objects, which needs an environment
+static void release_traceback(void *ptr)
+{
+    em_defer(free_traceback, ptr);
+}
+
+static void signal_python_error(PyObject *etype, PyObject *eval, PyObject *etb)
+{
+    PyErr_NormalizeException(&etype, &eval, &etb);
+
+    const char *type = PyType_Check(etype) ? ((PyTypeObject *)etype)->tp_name : "Exception";
+    emacs_value em_type = em_str(type);
+
+    emacs_value em_msg = NULL;
+    PyObject *msg = eval ? PyObject_Str(eval) : NULL;
+    if (msg) {
+        if (!EmacsObject__string(msg, &em_msg))
+            em_msg = NULL;
+        Py_DECREF(msg);
+    }
+    if (!em_msg) {
+        PyErr_Clear();
+        em_msg = em_str("");
+    }
+
+    // The triple steals the references
+    PyObject *triple = PyTuple_New(3);
+    PyTuple_SET_ITEM(triple, 0, etype);
+    PyTuple_SET_ITEM(triple, 1, eval ? eval : (Py_INCREF(Py_None), Py_None));
+    PyTuple_SET_ITEM(triple, 2, etb ? etb : (Py_INCREF(Py_None), Py_None));
+    emacs_value em_tb = em_user_ptr(release_traceback, triple);
+
+    em_signal(em__python_error, em_funcall_3(em__list, em_type, em_msg, em_tb));
+}
+
 bool propagate_python_error()
 {
     // Catch all exceptions
@@ -17,49 +62,38 @@ bool propagate_python_error()
     if (!etype)
         return false;
 
-    PyObject *args = PyObject_GetAttrString(eval, "args");
-    emacs_value symbol, data;
-
     // If the exception is of type EmacsSignal or EmacsThrow, and was raised
     // with two arguments, both of which are Emacs objects, we can signal or
-    // throw a corresponding non-local exit in Emacs
-    if ((etype == EmacsSignal || etype == EmacsThrow) && args
-        && PyObject_TypeCheck(args, &PyTuple_Type)
-        && PyTuple_Size(args) >= 2
-        && EmacsObject__coerce(PyTuple_GetItem(args, 0), 1, &symbol)
-        && EmacsObject__coerce(PyTuple_GetItem(args, 1), 0, &data)
-        && em_symbolp(symbol))
-    {
-        if (etype == EmacsSignal)
-            em_signal(symbol, data);
-        else if (etype == EmacsThrow)
-            em_throw(symbol, data);
-        Py_XDECREF(etype);
-        Py_XDECREF(eval);
-        Py_XDECREF(etb);
-        return true;
-    }
+    // throw a corresponding non-local exit in Emacs. These are used for control
+    // flow, so read the arguments directly: an exception set from C may not
+    // even be normalized, in which case the value is the argument tuple.
+    bool is_signal = PyErr_GivenExceptionMatches(etype, EmacsSignal);
+    if (is_signal || PyErr_GivenExceptionMatches(etype, EmacsThrow)) {
+        PyObject *args = NULL;
+        if (eval && PyTuple_Check(eval))
+            args = eval;
+        else if (eval && PyExceptionInstance_Check(eval))
+            args = ((PyBaseExceptionObject *)eval)->args;
 
-    // Otherwise, simply signal an error. If the exception has an .args,
-    // first element of which is a string, use that Otherwise try to repr()
-    // the exception.
-    char *msg = NULL;
-    if (args && PyArg_ParseTuple(args, "s", &msg))
-        ;
-    else {
-        PyObject *repr = PyObject_Repr(eval);
-        if (repr)
-            msg = PyUnicode_AsUTF8(repr);
-        Py_XDECREF(repr);
+        emacs_value symbol, data;
+        if (args && PyTuple_Check(args) && PyTuple_GET_SIZE(args) >= 2
+            && EmacsObject__convert(PyTuple_GET_ITEM(args, 0), CONVERT_SYMBOL, &symbol)
+            && EmacsObject__convert(PyTuple_GET_ITEM(args, 1), 0, &data)
+            && em_symbolp(symbol))
+        {
+            if (is_signal)
+                em_signal(symbol, data);
+            else
+                em_throw(symbol, data);
+            Py_XDECREF(etype);
+            Py_XDECREF(eval);
+            Py_XDECREF(etb);
+            return true;
+        }
+        PyErr_Clear();
     }
 
-    if (!msg)
-        msg = "An unknown error occured";
-    em_error(msg);
-
-    Py_XDECREF(etype);
-    Py_XDECREF(eval);
-    Py_XDECREF(etb);
+    signal_python_error(etype, eval, etb);
     return true;
 }
 
@@ -82,3 +116,46 @@ bool propagate_emacs_error()
     PyErr_SetObject(type, args);
     return true;
 }
+
+PUBLIC_DOCSTRING(format_traceback,
+                 "(tripoli-python-error-traceback TRACEBACK)\n\n"
+                 "Formats the Python traceback TRACEBACK as a string. TRACEBACK is the last "
+                 "element of the data of a `tripoli-python-error' signal.")
+emacs_value format_traceback(emacs_env *env, ptrdiff_t nargs, emacs_value *args, void *data)
+{
+    UNUSED(nargs); UNUSED(data);
+    push_env(env);
+
+    em_finalizer fin = NULL;
+    PyObject *triple = NULL;
+    if (em_type_is(args[0], em__user_ptr))
+        triple = (PyObject *)em_get_user_ptr(args[0], &fin);
+    if (fin != release_traceback) {
+        em_error("Expected a Python traceback");
+        POP_ENV_AND_RETURN(em__nil);
+    }
+
+    PyObject *module = PyImport_ImportModule("traceback");
+    PyObject *lines = module ? PyObject_CallMethod(module, "format_exception", "OOO",
+                                                   PyTuple_GET_ITEM(triple, 0),
+                                                   PyTuple_GET_ITEM(triple, 1),
+                                                   PyTuple_GET_ITEM(triple, 2)) : NULL;
+    Py_XDECREF(module);
+
+    PyObject *empty = PyUnicode_FromString("");
+    PyObject *text = lines ? PyUnicode_Join(empty, lines) : NULL;
+    Py_DECREF(empty);
+    Py_XDECREF(lines);
+
+    if (propagate_python_error())
+        POP_ENV_AND_RETURN(em__nil);
+
+    emacs_value ret;
+    bool success = EmacsObject__string(text, &ret);
+    Py_DECREF(text);
+    if (!success) {
+        propagate_python_error();
+        POP_ENV_AND_RETURN(em__nil);
+    }
+    POP_ENV_AND_RETURN(ret);
+}
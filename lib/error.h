@@ -1,6 +1,8 @@
 #ifndef ERROR_H
 #define ERROR_H
 
+#include "util.h"
+
 
 /**
  * \brief Check for Python errors having been thrown, and create Emacs errors.
@@ -9,6 +11,10 @@
  * indicator is set. If it is, the error is converted to an Emacs non-local exit
  * signal as appropriate, and the Python error indicator is cleared.
  *
+ * Exceptions of type Signal and Throw become the corresponding non-local exits.
+ * Other exceptions are signalled as (tripoli-python-error TYPE MSG TRACEBACK),
+ * where TRACEBACK is an opaque object that can be formatted on demand.
+ *
  * \return True if an error was present, false otherwise.
  */
 bool propagate_python_error();
@@ -24,5 +30,8 @@ bool propagate_python_error();
  */
 bool propagate_emacs_error();
 
+EXTERN_DOCSTRING(format_traceback)
+emacs_value format_traceback(emacs_env *env, ptrdiff_t nargs, emacs_value *args, void *data);
+
 
 #endif /* ERROR_H */
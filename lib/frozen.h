@@ -0,0 +1,24 @@
+#include <stdbool.h>
+
+#ifndef FROZEN_H
+#define FROZEN_H
+
+
+/**
+ * \brief A module of the tripoli package, compiled and marshalled at build time
+ * by freeze.py.
+ */
+typedef struct {
+    const char *name;
+    const unsigned char *code;
+    int size;
+    bool package;
+} FrozenModule;
+
+/**
+ * \brief The frozen modules, terminated by an entry with a NULL name.
+ */
+extern const FrozenModule tripoli_frozen_modules[];
+
+
+#endif /* FROZEN_H */
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdio.h>
+#include <time.h>
 #include <wordexp.h>
 #include <emacs-module.h>
 #include <Python.h>
@@ -11,6 +12,94 @@
 
 #include "main.h"
 
+#ifdef TRIPOLI_FROZEN
+#include "frozen.h"
+#endif
+
+
+
+// Startup
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#ifdef TRIPOLI_FROZEN
+// Add the tripoli package to the modules that are already frozen into Python
+static void install_frozen_modules()
+{
+    size_t n = 0, m = 0;
+    while (PyImport_FrozenModules[n].name)
+        n++;
+    while (tripoli_frozen_modules[m].name)
+        m++;
+
+    struct _frozen *modules = (struct _frozen *)calloc(n + m + 1, sizeof(struct _frozen));
+    memcpy(modules, PyImport_FrozenModules, n * sizeof(struct _frozen));
+    for (size_t i = 0; i < m; i++) {
+        const FrozenModule *src = &tripoli_frozen_modules[i];
+        struct _frozen *dst = &modules[n + i];
+        dst->name = src->name;
+        dst->code = src->code;
+#if PY_VERSION_HEX >= 0x030B0000
+        dst->size = src->size;
+        dst->is_package = src->package;
+#else
+        dst->size = src->package ? -src->size : src->size;
+#endif
+    }
+    PyImport_FrozenModules = modules;
+}
+#endif
+
+// The value of a variable as a boolean, or a default if it's unbound
+static bool variable_or(const char *name, bool dflt)
+{
+    emacs_value symbol = em_intern(name);
+    if (em_truthy(em_funcall_1(em__boundp, symbol)))
+        return em_truthy(em_funcall_1(em__symbol_value, symbol));
+    return dflt;
+}
+
+static bool initialize_python()
+{
+    bool isolated = variable_or("tripoli-isolated", false);
+
+    // The site module adds site-packages to the path. Unless frozen, the
+    // tripoli package itself is usually found there.
+#ifdef TRIPOLI_FROZEN
+    bool site = variable_or("tripoli-site-import", false);
+    install_frozen_modules();
+#else
+    bool site = variable_or("tripoli-site-import", true);
+#endif
+
+#if PY_VERSION_HEX >= 0x03080000
+    PyConfig config;
+    if (isolated)
+        PyConfig_InitIsolatedConfig(&config);
+    else
+        PyConfig_InitPythonConfig(&config);
+    config.site_import = site;
+    config.parse_argv = 0;
+
+    PyStatus status = PyConfig_SetString(&config, &config.program_name, L"Tripoli");
+    if (!PyStatus_Exception(status))
+        status = Py_InitializeFromConfig(&config);
+    PyConfig_Clear(&config);
+    return !PyStatus_Exception(status);
+#else
+    Py_NoSiteFlag = !site;
+    Py_IsolatedFlag = isolated;
+    Py_SetProgramName(L"Tripoli");
+    Py_Initialize();
+    return true;
+#endif
+}
+
 
 int emacs_module_init(struct emacs_runtime *ert)
 {
@@ -26,18 +115,29 @@ int emacs_module_init(struct emacs_runtime *ert)
     push_env(env);
     populate();
 
-    Py_SetProgramName((wchar_t *)"Tripoli");
+    double start = now();
     PyImport_AppendInittab("emacs_raw", PyInit_emacs_raw);
-    Py_Initialize();
+    if (!initialize_python()) {
+        pop_env();
+        return 3;
+    }
+    record_startup_phase("python", now() - start);
 
+    start = now();
     em_defun(exec_buffer, "tripoli-exec-buffer", 0, 0, true, NULL, __doc_exec_buffer, NULL);
     em_defun(exec_file, "tripoli-exec-file", 1, 1, true, em_str("fPython file: "), __doc_exec_file, NULL);
     em_defun(exec_str, "tripoli-exec-str", 1, 1, false, NULL, __doc_exec_str, NULL);
     em_defun(import_module, "tripoli-import", 1, 1, true, em_str("sModule: "), __doc_import_module, NULL);
     em_defun(exec_tests, "tripoli-test", 0, emacs_variadic_function, true, NULL, __doc_exec_tests, NULL);
     em_defun(exec_repl, "tripoli-repl", 0, 0, true, NULL, __doc_exec_repl, NULL);
+    em_defun(exec_ref_report, "tripoli-ref-report", 0, 0, true, NULL, __doc_exec_ref_report, NULL);
+    em_defun(format_traceback, "tripoli-python-error-traceback", 1, 1, false, NULL,
+             __doc_format_traceback, NULL);
+
+    em_funcall_2(em_intern("define-error"), em__python_error, em_str("Python error"));
 
     em_provide("libtripoli");
+    record_startup_phase("define", now() - start);
 
     maybe_run_init();
 
@@ -66,7 +166,16 @@ void maybe_run_init()
     if (!fp)
         return;
 
+    // The init file imports tripoli anyway, so time that separately
+    double start = now();
+    PyObject *module = PyImport_ImportModule("tripoli");
+    Py_XDECREF(module);
+    PyErr_Clear();
+    record_startup_phase("import", now() - start);
+
+    start = now();
     int rv = PyRun_SimpleFileEx(fp, filename, 1);
+    record_startup_phase("init", now() - start);
     if (rv < 0)
         em_error("An exception was raised");
 }
@@ -250,3 +359,23 @@ emacs_value exec_repl(emacs_env *env, ptrdiff_t nargs, emacs_value *args, void *
 
     POP_ENV_AND_RETURN(em__nil);
 }
+
+
+emacs_value exec_ref_report(emacs_env *env, ptrdiff_t nargs, emacs_value *args, void *data)
+{
+    UNUSED(nargs); UNUSED(args); UNUSED(data);
+    push_env(env);
+
+    PyObject *module = PyImport_ImportModule("tripoli.refs");
+    if (!module) {
+        em_error("Failed to import refs module");
+        POP_ENV_AND_RETURN(em__nil);
+    }
+
+    PyObject *ret = PyObject_CallMethod(module, "report", NULL);
+    Py_DECREF(module);
+    Py_XDECREF(ret);
+    propagate_python_error();
+
+    POP_ENV_AND_RETURN(em__nil);
+}
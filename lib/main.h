@@ -38,5 +38,11 @@ DOCSTRING(exec_repl,
           "Run a Python REPL in the terminal.")
 emacs_value exec_repl(emacs_env *env, ptrdiff_t nargs, emacs_value *args, void *data);
 
+DOCSTRING(exec_ref_report,
+          "(tripoli-ref-report)\n\n"
+          "Displays statistics about Emacs objects referenced from Python, "
+          "together with garbage collector statistics.")
+emacs_value exec_ref_report(emacs_env *env, ptrdiff_t nargs, emacs_value *args, void *data);
+
 
 #endif /* MAIN_H */
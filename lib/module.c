@@ -1,9 +1,15 @@
 #include <Python.h>
 
+#include "batch.h"
+#include "buffer.h"
+#include "diff.h"
 #include "emacs-interface.h"
 #include "error.h"
 #include "object.h"
+#include "sort.h"
+#include "symbols.h"
 #include "util.h"
+#include "vector.h"
 
 #include "module.h"
 
@@ -11,34 +17,193 @@
 
 // Callback
 
+Callback *Callback__new(PyObject *function, bool raw, int returns)
+{
+    Callback *cb = (Callback *)malloc(sizeof(Callback));
+    Py_INCREF(function);
+    cb->function = function;
+    cb->raw = raw;
+    cb->handles = false;
+    cb->returns = returns;
+    return cb;
+}
+
+static PyObject *vectorcall(PyObject *function, PyObject **args, Py_ssize_t nargs)
+{
+#if PY_VERSION_HEX >= 0x03090000
+    return PyObject_Vectorcall(function, args, nargs, NULL);
+#elif PY_VERSION_HEX >= 0x03080000
+    return _PyObject_Vectorcall(function, args, nargs, NULL);
+#else
+    PyObject *arglist = PyTuple_New(nargs);
+    if (!arglist)
+        return NULL;
+    for (Py_ssize_t i = 0; i < nargs; i++) {
+        Py_INCREF(args[i]);
+        PyTuple_SET_ITEM(arglist, i, args[i]);
+    }
+    PyObject *ret = PyObject_CallObject(function, arglist);
+    Py_DECREF(arglist);
+    return ret;
+#endif
+}
+
+// The value returned to Emacs may be backed by a global reference owned by the
+// Python return value, so that object must outlive the call. Emacs has consumed
+// the value by the time any other callback runs, so it is released then.
+static PyObject *__last_return = NULL;
+
 emacs_value call_function(emacs_env *env, ptrdiff_t nargs, emacs_value *args, void *data)
 {
     push_env(env);
 
-    PyObject *function = (PyObject *)data;
-    PyObject *arglist = PyTuple_New(nargs);
-    for (int i = 0; i < nargs; i++) {
-        PyObject *arg = EmacsObject__make(&EmacsObjectType, args[i]);
-        PyTuple_SetItem(arglist, i, arg);
+    Callback *cb = (Callback *)data;
+    PyObject *arglist[nargs > 0 ? nargs : 1];
+    for (ptrdiff_t i = 0; i < nargs; i++) {
+        // Handles are passed as the Python objects they own
+        if (cb->handles && (arglist[i] = EmacsObject__unwrap(args[i])))
+            continue;
+        arglist[i] = cb->raw ? EmacsObject__make_local(&EmacsObjectType, args[i])
+                             : EmacsObject__make(&EmacsObjectType, args[i]);
+        if (!arglist[i]) {
+            while (i--)
+                Py_DECREF(arglist[i]);
+            propagate_python_error();
+            POP_ENV_AND_RETURN(NULL);
+        }
     }
 
-    PyObject *py_ret = PyObject_CallObject(function, arglist);
-    Py_DECREF(arglist);
+    PyObject *py_ret = vectorcall(cb->function, arglist, nargs);
+
+    for (ptrdiff_t i = 0; i < nargs; i++) {
+        if (cb->raw && Py_REFCNT(arglist[i]) > 1
+            && PyObject_TypeCheck(arglist[i], &EmacsObjectType))
+            EmacsObject__promote((EmacsObject *)arglist[i]);
+        Py_DECREF(arglist[i]);
+    }
 
     if (propagate_python_error())
         POP_ENV_AND_RETURN(NULL);
 
     emacs_value ret;
-    if (!EmacsObject__coerce(py_ret, 0, &ret)) {
-        em_error("Function failed to return a valid Emacs object");
+    if (!EmacsObject__convert(py_ret, cb->returns, &ret)) {
+        Py_DECREF(py_ret);
+        if (!propagate_python_error())
+            em_error("Function failed to return a valid Emacs object");
         POP_ENV_AND_RETURN(NULL);
     }
 
+    PyObject *prev = __last_return;
+    __last_return = py_ret;
+    Py_XDECREF(prev);
+
     POP_ENV_AND_RETURN(ret);
 }
 
 
-
+
+// Autoloads
+//
+// An autoloaded command is first defined as a stub, which imports the Python
+// function when called, redefines the command as that function and calls it.
+
+typedef struct {
+    char *name, *module, *attr, *doc;
+    bool interactive;
+    emacs_value spec;
+} Autoload;
+
+static emacs_value call_autoload(emacs_env *env, ptrdiff_t nargs, emacs_value *args, void *data)
+{
+    push_env(env);
+
+    Autoload *al = (Autoload *)data;
+    PyObject *module = PyImport_ImportModule(al->module);
+    PyObject *function = module ? PyObject_GetAttrString(module, al->attr) : NULL;
+    Py_XDECREF(module);
+    if (function && !PyCallable_Check(function)) {
+        PyErr_Format(PyExc_TypeError, "%s.%s is not callable", al->module, al->attr);
+        Py_CLEAR(function);
+    }
+    if (!function) {
+        propagate_python_error();
+        POP_ENV_AND_RETURN(NULL);
+    }
+
+    // Prefer the docstring of the real function
+    PyObject *pydoc = PyObject_GetAttrString(function, "__doc__");
+    const char *doc = NULL;
+    if (pydoc && PyUnicode_Check(pydoc))
+        doc = PyUnicode_AsUTF8(pydoc);
+    if (!doc) {
+        PyErr_Clear();
+        doc = al->doc;
+    }
+
+    em_defun(call_function, al->name, 0, emacs_variadic_function, al->interactive, al->spec,
+             doc, Callback__new(function, false, 0));
+    Py_XDECREF(pydoc);
+    Py_DECREF(function);
+
+    emacs_value ret = em_funcall(em_intern(al->name), Py_SAFE_DOWNCAST(nargs, ptrdiff_t, int), args);
+    POP_ENV_AND_RETURN(ret);
+}
+
+DOCSTRING(py_autoload,
+          "autoload(name, module, attr, interactive=False, doc=None)\n\n"
+          "Defines an Emacs function `name` that calls the Python function `attr` in "
+          "`module`, without importing the module until the function is first called, "
+          "like :lisp:`autoload`. The first call redefines `name` as the Python function, "
+          "so later calls go directly to it.\n\n"
+          "If `interactive` is true, the function is a command. It may also be a string, "
+          "which is then used as the interactive spec. The arguments are passed as for "
+          ":func:`function`.")
+PyObject *py_autoload(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    UNUSED(self);
+    const char *name, *module, *attr, *doc = NULL;
+    PyObject *interactive = Py_False;
+    char *keywords[] = {"name", "module", "attr", "interactive", "doc", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sss|Oz", keywords,
+                                     &name, &module, &attr, &interactive, &doc))
+        return NULL;
+
+    emacs_value spec = NULL;
+    if (PyUnicode_Check(interactive)) {
+        if (!EmacsObject__string(interactive, &spec))
+            return NULL;
+        spec = em_make_global(spec);
+    }
+    int is_interactive = PyObject_IsTrue(interactive);
+    if (is_interactive < 0)
+        return NULL;
+
+    PyObject *default_doc = NULL;
+    if (!doc) {
+        default_doc = PyUnicode_FromFormat("Autoloaded from the Python module %s.", module);
+        if (!default_doc)
+            return NULL;
+        doc = PyUnicode_AsUTF8(default_doc);
+    }
+
+    Autoload *al = (Autoload *)malloc(sizeof(Autoload));
+    al->name = strdup(name);
+    al->module = strdup(module);
+    al->attr = strdup(attr);
+    al->doc = strdup(doc);
+    al->interactive = is_interactive;
+    al->spec = spec;
+    Py_XDECREF(default_doc);
+
+    em_defun(call_autoload, al->name, 0, emacs_variadic_function, al->interactive, al->spec,
+             al->doc, al);
+    if (propagate_emacs_error())
+        return NULL;
+    return EmacsObject__make(&EmacsObjectType, symbols_intern(name));
+}
+
+
+
 // Constructors
 
 DOCSTRING(py_intern,
@@ -52,7 +217,11 @@ PyObject *py_intern(PyObject *self, PyObject *args)
     char *name;
     if (!PyArg_ParseTuple(args, "s", &name))
         return NULL;
-    return EmacsObject__make(&EmacsObjectType, em_intern(name));
+    if (!strcmp(name, "nil"))
+        return EmacsObject__nil();
+    if (!strcmp(name, "t"))
+        return EmacsObject__t();
+    return EmacsObject__make(&EmacsObjectType, symbols_intern(name));
 }
 
 DOCSTRING(py_str,
@@ -62,21 +231,22 @@ PyObject *py_str(PyObject *self, PyObject *args)
 {
     UNUSED(self);
     PyObject *arg, *pystr;
-    char *cstr;
     if (!PyArg_ParseTuple(args, "O", &arg))
         return NULL;
     if (!(pystr = PyObject_Str(arg)))
         return NULL;
-    cstr = PyUnicode_AsUTF8(pystr);
+    emacs_value str;
+    bool success = EmacsObject__string(pystr, &str);
     Py_DECREF(pystr);
-    if (!cstr)
+    if (!success)
         return NULL;
-    return EmacsObject__make(&EmacsObjectType, em_str(cstr));
+    return EmacsObject__make(&EmacsObjectType, str);
 }
 
 DOCSTRING(py_int,
           "int(i)\n\n"
-          "Creates an :class:`.EmacsObject` of integer type.")
+          "Creates an :class:`.EmacsObject` of integer type. Integers that don't fit in a "
+          "fixnum become bignums, which requires Emacs 27 or later.")
 PyObject *py_int(PyObject *self, PyObject *args)
 {
     UNUSED(self);
@@ -85,12 +255,21 @@ PyObject *py_int(PyObject *self, PyObject *args)
         return NULL;
     if (!(pyint = PyNumber_Long(arg)))
         return NULL;
+
     int overflow;
-    intmax_t val = PyLong_AsLongAndOverflow(pyint, &overflow);
+    long long small = PyLong_AsLongLongAndOverflow(pyint, &overflow);
+    PyObject *shared = overflow ? NULL : EmacsObject__small_int(small);
+    if (shared || PyErr_Occurred()) {
+        Py_DECREF(pyint);
+        return shared;
+    }
+
+    emacs_value val;
+    bool success = EmacsObject__int(pyint, &val);
     Py_DECREF(pyint);
-    if (PyErr_Occurred() || overflow)
+    if (!success)
         return NULL;
-    return EmacsObject__make(&EmacsObjectType, em_int(val));
+    return EmacsObject__make(&EmacsObjectType, val);
 }
 
 DOCSTRING(py_float,
@@ -111,21 +290,63 @@ PyObject *py_float(PyObject *self, PyObject *args)
     return EmacsObject__make(&EmacsObjectType, em_float(val));
 }
 
+DOCSTRING(py_small_int_range,
+          "small_int_range(low, high)\n\n"
+          "Sets the range of integers, inclusive, that have shared :class:`.EmacsObject` "
+          "wrappers, and returns the previous range as a tuple. With no arguments, "
+          "returns the current range without changing it. The default is -5 to 256.\n\n"
+          "Like :code:`nil` and :code:`t`, these integers are wrapped once when first "
+          "used. Constructors and conversions then return the shared wrappers without "
+          "calling Emacs. If `high` is less than `low`, no integers are shared.")
+PyObject *py_small_int_range(PyObject *self, PyObject *args)
+{
+    UNUSED(self);
+    long long low, high;
+    if (!PyArg_ParseTuple(args, "|LL", &low, &high))
+        return NULL;
+
+    bool set = PyTuple_Size(args) > 0;
+    if (PyTuple_Size(args) == 1) {
+        PyErr_SetString(PyExc_TypeError, "Both bounds of the range are required");
+        return NULL;
+    }
+    if (set && high >= low && (unsigned long long)high - (unsigned long long)low >= (1 << 16)) {
+        PyErr_SetString(PyExc_ValueError, "Range is too large");
+        return NULL;
+    }
+
+    intmax_t ilow = set ? low : 0, ihigh = set ? high : 0;
+    EmacsObject__small_int_range(&ilow, &ihigh, set);
+    return Py_BuildValue("(LL)", (long long)ilow, (long long)ihigh);
+}
+
 DOCSTRING(py_function,
-          "function(callback, nargs_min=0, nargs_max=PTRDIFF_MAX)\n\n"
+          "function(callback, nargs_min=0, nargs_max=PTRDIFF_MAX, raw=False, returns=None, "
+          "handles=False)\n\n"
           "Creates an Emacs function object with the specificed arity which, when called, "
           "will run the given callback function and return its value to the Emacs caller, "
           "provided the return value is coercible to an :class:`.EmacsObject`.\n\n"
           "If exceptions of type :class:`.Signal` or :class:`.Throw` are raised with "
           "appropriate arguments, the corresponding effect will be propagated to Emacs. "
-          "All other exceptions are propagated as error signals.")
+          "All other exceptions are propagated as error signals.\n\n"
+          "If `raw` is true, the arguments are passed as borrowed handles that are only "
+          "guaranteed to be valid during the call. This avoids pinning each argument, "
+          "which makes frequently called functions (hooks, advice) considerably cheaper. "
+          "Arguments still referenced when the callback returns are pinned automatically.\n\n"
+          "If `handles` is true, arguments that are handles made by :func:`handle` are "
+          "passed as the Python objects they wrap.\n\n"
+          "The return value is converted as by :func:`convert`, with `returns` as the shape.")
 PyObject *py_function(PyObject *self, PyObject *args, PyObject *kwds)
 {
     UNUSED(self);
-    PyObject *fcn;
-    ptrdiff_t min_nargs = 0, max_nargs = PTRDIFF_MAX;
-    char *keywords[] = {"self", "min_nargs", "max_nargs", NULL};
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|ii", keywords, &fcn, &min_nargs, &max_nargs))
+    PyObject *fcn, *shape = NULL;
+    Py_ssize_t min_nargs = 0, max_nargs = PTRDIFF_MAX;
+    int raw = false, handles = false, returns;
+    char *keywords[] = {"self", "min_nargs", "max_nargs", "raw", "returns", "handles", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|nnpOp", keywords,
+                                     &fcn, &min_nargs, &max_nargs, &raw, &shape, &handles))
+        return NULL;
+    if (!EmacsObject__parse_shape(shape, &returns))
         return NULL;
     if (!PyCallable_Check(fcn)) {
         PyErr_SetString(PyExc_TypeError, "Parameter must be callable");
@@ -137,11 +358,44 @@ PyObject *py_function(PyObject *self, PyObject *args, PyObject *kwds)
     if (pydoc && PyUnicode_Check(pydoc) && !(doc = PyUnicode_AsUTF8(pydoc)))
         PyErr_Clear();
 
-    Py_XINCREF(fcn);
-    emacs_value func = em_function(call_function, min_nargs, max_nargs, doc, fcn);
+    Callback *cb = Callback__new(fcn, raw, returns);
+    cb->handles = handles;
+    emacs_value func = em_function(call_function, min_nargs, max_nargs, doc, cb);
     return EmacsObject__make(&EmacsObjectType, func);
 }
 
+DOCSTRING(py_convert,
+          "convert(obj, shape=None)\n\n"
+          "Converts a Python object to an :class:`.EmacsObject` in a single pass. "
+          "This follows the same rules as the :class:`.EmacsObject` constructor, but "
+          "the shape of the result can be chosen with `shape`, which is a string or a "
+          "tuple of strings from the following.\n\n"
+          "- :code:`'symbol'`: strings become symbols.\n"
+          "- :code:`'vector'`: lists and tuples become vectors instead of lists.\n"
+          "- :code:`'alist'`: dicts become alists.\n"
+          "- :code:`'hash-table'`: dicts become hash tables using :lisp:`equal`.\n"
+          "- :code:`'symbol-keys'`: string keys in dicts become symbols.\n\n"
+          "Without a dict shape, dicts are not converted.")
+PyObject *py_convert(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    UNUSED(self);
+    PyObject *arg, *shape = NULL;
+    int flags;
+    char *keywords[] = {"obj", "shape", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", keywords, &arg, &shape))
+        return NULL;
+    if (!EmacsObject__parse_shape(shape, &flags))
+        return NULL;
+
+    emacs_value ret;
+    if (!EmacsObject__convert(arg, flags, &ret)) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_TypeError, "Unable to convert to Emacs object");
+        return NULL;
+    }
+    return EmacsObject__make(&EmacsObjectType, ret);
+}
+
 DOCSTRING(py_cons,
           "cons(car=None, cdr=None)\n\n"
           "Creates an :class:`.EmacsObject` of cons type. "
@@ -154,7 +408,7 @@ PyObject *py_cons(PyObject *self, PyObject *args)
         return NULL;
 
     if (car == Py_None)
-        return EmacsObject__make(&EmacsObjectType, em__nil);
+        return EmacsObject__nil();
 
     emacs_value ecar = ((EmacsObject *)car)->val;
 
@@ -174,7 +428,7 @@ PyObject *py_list(PyObject *self, PyObject *args)
 {
     UNUSED(self);
     if (PyTuple_Size(args) == 0)
-        return EmacsObject__make(&EmacsObjectType, em__nil);
+        return EmacsObject__nil();
 
     PyObject *arg;
     if (!PyArg_ParseTuple(args, "O", &arg))
@@ -216,49 +470,325 @@ PyObject *py_list(PyObject *self, PyObject *args)
 DOCSTRING(py_vector,
           "vector(iterable)\n\n"
           "Creates an :class:`.EmacsObject` of vector type. "
-          "All elements of the iterable must be Emacs objects.")
+          "All elements of the iterable must be Emacs objects.\n\n"
+          "If the argument supports the buffer protocol, e.g. an :code:`array.array` or "
+          ":code:`bytes`, it is instead copied in one pass to a vector of numbers. "
+          "See also :func:`to_array`.")
 PyObject *py_vector(PyObject *self, PyObject *args)
 {
     UNUSED(self);
 
-    size_t max_args = 100, nargs = 0;
-    emacs_value *eargs = (emacs_value *)malloc(max_args * sizeof(emacs_value));
-
-    if (PyTuple_Size(args) != 0) {
-        PyObject *arg;
-        if (!PyArg_ParseTuple(args, "O", &arg))
+    PyObject *buffer;
+    if (PyTuple_Size(args) == 1 && PyObject_CheckBuffer(buffer = PyTuple_GET_ITEM(args, 0))) {
+        emacs_value vector;
+        if (!vector_from_buffer(buffer, &vector))
             return NULL;
+        return EmacsObject__make(&EmacsObjectType, vector);
+    }
+
+    if (PyTuple_Size(args) == 0)
+        return EmacsObject__make(&EmacsObjectType, em_make_vector(0, em__nil));
 
-        PyObject *iterator = PyObject_GetIter(arg);
-        if (!iterator)
+    PyObject *arg;
+    if (!PyArg_ParseTuple(args, "O", &arg))
+        return NULL;
+    PyObject *seq = PySequence_Fast(arg, "Expected an iterable");
+    if (!seq)
+        return NULL;
+
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(seq);
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+    for (Py_ssize_t i = 0; i < size; i++) {
+        if (!PyObject_TypeCheck(items[i], &EmacsObjectType)) {
+            PyErr_SetString(PyExc_TypeError, "Expected EmacsObject");
+            Py_DECREF(seq);
             return NULL;
-        PyObject *item;
-        while ((item = PyIter_Next(iterator))) {
-            if (!PyObject_TypeCheck(item, &EmacsObjectType)) {
-                PyErr_SetString(PyExc_TypeError, "Expected EmacsObject");
-                Py_DECREF(iterator);
-                free(eargs);
-                return NULL;
-            }
-            eargs[nargs++] = ((EmacsObject *)item)->val;
-            if (nargs == max_args) {
-                max_args *= 2;
-                eargs = (emacs_value *)realloc(eargs, max_args * sizeof(emacs_value));
-            }
-
-            Py_DECREF(item);
         }
-
-        Py_DECREF(iterator);
     }
 
-    emacs_value vector = em_funcall(em__vector, nargs, eargs);
-    free(eargs);
+    emacs_value vector = em_make_vector(size, em__nil);
+    for (Py_ssize_t i = 0; i < size; i++)
+        em_vec_set(vector, i, ((EmacsObject *)items[i])->val);
+    Py_DECREF(seq);
+
     return EmacsObject__make(&EmacsObjectType, vector);
 }
 
 
 
+// Arithmetic
+
+DOCSTRING(py_arithmetic_result,
+          "arithmetic_result(kind=None)\n\n"
+          "Sets the type of results of arithmetic involving :class:`.EmacsObject` instances, "
+          "and returns the previous setting. The kind is either :code:`'python'` (the "
+          "default), in which case results are Python numbers, or :code:`'emacs'`, in "
+          "which case they are Emacs numbers. With no argument, returns the current "
+          "setting without changing it.\n\n"
+          "The setting is global, so it changes the results for all code, including "
+          "other packages and tripoli's own types. Prefer "
+          ":func:`tripoli.util.arithmetic_result`, which sets it only within a "
+          ":code:`with` block.\n\n"
+          "Numbers that fit in machine words are computed natively in either case. "
+          "Integer results that don't fit are computed with the equivalent Lisp functions "
+          "for Emacs results, so that they become Emacs bignums without passing through "
+          "Python. Everything else, including errors such as division by zero, follows "
+          "Python semantics.")
+PyObject *py_arithmetic_result(PyObject *self, PyObject *args)
+{
+    UNUSED(self);
+    const char *kind = NULL;
+    if (!PyArg_ParseTuple(args, "|z", &kind))
+        return NULL;
+
+    PyObject *ret = PyUnicode_FromString(EmacsObject__emacs_results_p() ? "emacs" : "python");
+    if (!ret || !kind)
+        return ret;
+
+    if (!strcmp(kind, "emacs"))
+        EmacsObject__emacs_results(true);
+    else if (!strcmp(kind, "python"))
+        EmacsObject__emacs_results(false);
+    else {
+        Py_DECREF(ret);
+        PyErr_Format(PyExc_ValueError, "Unknown result kind: '%s'", kind);
+        return NULL;
+    }
+    return ret;
+}
+
+
+
+// Compiled functions
+
+static PyObject *__compiled = NULL;
+
+DOCSTRING(py_byte_compile,
+          "byte_compile(form)\n\n"
+          "Byte-compiles a lambda form with lexical binding, and returns the compiled "
+          "function. The form is either a string of Lisp source code or an "
+          ":class:`.EmacsObject`.\n\n"
+          "Compiled functions are cached by the source string, or by the printed "
+          "representation of the form, so this can be called repeatedly with the same "
+          "form at little cost. This makes it cheap to run loops over Emacs data "
+          "entirely in the Lisp VM, with a single function call from Python.")
+PyObject *py_byte_compile(PyObject *self, PyObject *args)
+{
+    UNUSED(self);
+    PyObject *form;
+    if (!PyArg_ParseTuple(args, "O", &form))
+        return NULL;
+
+    PyObject *key;
+    if (PyUnicode_Check(form)) {
+        key = form;
+        Py_INCREF(key);
+    }
+    else if (PyObject_TypeCheck(form, &EmacsObjectType))
+        key = PyObject_Repr(form);
+    else {
+        PyErr_SetString(PyExc_TypeError, "Expected a string or an Emacs object");
+        return NULL;
+    }
+    if (!key)
+        return NULL;
+
+    if (!__compiled && !(__compiled = PyDict_New())) {
+        Py_DECREF(key);
+        return NULL;
+    }
+
+    PyObject *ret = PyDict_GetItem(__compiled, key);
+    if (ret) {
+        Py_DECREF(key);
+        Py_INCREF(ret);
+        return ret;
+    }
+
+    emacs_value eform;
+    if (PyUnicode_Check(form)) {
+        const char *source = PyUnicode_AsUTF8(form);
+        if (!source) {
+            Py_DECREF(key);
+            return NULL;
+        }
+        eform = em_read(source);
+    }
+    else
+        eform = ((EmacsObject *)form)->val;
+
+    emacs_value func = em_byte_compile(eform);
+    if (propagate_emacs_error()) {
+        Py_DECREF(key);
+        return NULL;
+    }
+
+    ret = EmacsObject__make(&EmacsObjectType, func);
+    if (ret && PyDict_SetItem(__compiled, key, ret) < 0)
+        Py_CLEAR(ret);
+    Py_DECREF(key);
+    return ret;
+}
+
+
+
+// Handles
+
+DOCSTRING(py_handle,
+          "handle(obj)\n\n"
+          "Wraps any Python object in an opaque Emacs :lisp:`user-ptr`, without "
+          "converting it. Lisp code can store and pass around the handle, and the "
+          "object stays alive until Emacs collects the handle.\n\n"
+          "When a handle is passed to a function made by :func:`function` with "
+          ":code:`handles=True`, the callback receives the original Python object. "
+          "Use :func:`unwrap` to get it otherwise.")
+PyObject *py_handle(PyObject *self, PyObject *args)
+{
+    UNUSED(self);
+    PyObject *obj;
+    if (!PyArg_ParseTuple(args, "O", &obj))
+        return NULL;
+    emacs_value val = EmacsObject__handle(obj);
+    if (propagate_emacs_error())
+        return NULL;
+    return EmacsObject__make(&EmacsObjectType, val);
+}
+
+DOCSTRING(py_unwrap,
+          "unwrap(handle)\n\n"
+          "Returns the Python object wrapped by a handle made by :func:`handle`. "
+          "Raises :code:`TypeError` if the object is not such a handle.")
+PyObject *py_unwrap(PyObject *self, PyObject *args)
+{
+    UNUSED(self);
+    PyObject *obj;
+    if (!PyArg_ParseTuple(args, "O!", &EmacsObjectType, &obj))
+        return NULL;
+    PyObject *ret = EmacsObject__unwrap(((EmacsObject *)obj)->val);
+    if (!ret)
+        PyErr_SetString(PyExc_TypeError, "Expected a Python handle");
+    return ret;
+}
+
+
+
+// Startup
+
+static struct {
+    const char *phase;
+    double seconds;
+} __startup_times[8];
+static size_t __startup_phases = 0;
+
+void record_startup_phase(const char *phase, double seconds)
+{
+    if (__startup_phases < sizeof(__startup_times) / sizeof(__startup_times[0])) {
+        __startup_times[__startup_phases].phase = phase;
+        __startup_times[__startup_phases].seconds = seconds;
+        __startup_phases++;
+    }
+}
+
+DOCSTRING(py_startup_times,
+          "startup_times()\n\n"
+          "Returns the time spent in each phase of loading Tripoli, as a list of tuples "
+          ":code:`(phase, seconds)`. The phases are :code:`'python'`, initializing the "
+          "interpreter, :code:`'define'`, defining the Emacs functions, and, if an init "
+          "file is run, :code:`'import'`, importing the :code:`tripoli` package, and "
+          ":code:`'init'`, running the init file.")
+PyObject *py_startup_times(PyObject *self, PyObject *args)
+{
+    UNUSED(self); UNUSED(args);
+    PyObject *ret = PyList_New(__startup_phases);
+    for (size_t i = 0; ret && i < __startup_phases; i++) {
+        PyObject *item = Py_BuildValue("(sd)", __startup_times[i].phase, __startup_times[i].seconds);
+        if (!item) {
+            Py_CLEAR(ret);
+            break;
+        }
+        PyList_SET_ITEM(ret, i, item);
+    }
+    return ret;
+}
+
+
+
+// Reference accounting
+
+DOCSTRING(py_track_refs,
+          "track_refs(sites=True)\n\n"
+          "Enables or disables recording of the Python source location that creates each "
+          "Emacs object pinned from Python. Disabling discards the recorded sites. "
+          "Live references are always counted, see :func:`ref_stats`.")
+PyObject *py_track_refs(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    UNUSED(self);
+    int sites = true;
+    char *keywords[] = {"sites", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", keywords, &sites))
+        return NULL;
+    EmacsObject__track_sites(sites);
+    Py_RETURN_NONE;
+}
+
+DOCSTRING(py_ref_stats,
+          "ref_stats(top=10)\n\n"
+          "Returns a dict with statistics about Emacs global references. "
+          "The key `live` is the number of global references currently held, and "
+          "`created` is the number created so far. The key `objects` is the number of live "
+          "references owned by :class:`.EmacsObject` instances.\n\n"
+          "If sites are tracked (see :func:`track_refs`), `sites` is a list of at most `top` "
+          "tuples :code:`(filename, lineno, count)`, with the sites holding the most live "
+          "references first. Otherwise it is :code:`None`.")
+PyObject *py_ref_stats(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    UNUSED(self);
+    Py_ssize_t top = 10;
+    char *keywords[] = {"top", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", keywords, &top))
+        return NULL;
+
+    size_t live, total, objects;
+    em_global_stats(&live, &total);
+    PyObject *sites = EmacsObject__ref_stats(&objects);
+    if (!sites)
+        return NULL;
+
+    if (sites != Py_None) {
+        PyObject *list = PyList_New(0);
+        Py_ssize_t ppos = 0;
+        PyObject *key, *value;
+        while (list && PyDict_Next(sites, &ppos, &key, &value)) {
+            PyObject *entry = Py_BuildValue("(OOO)", value, PyTuple_GET_ITEM(key, 0),
+                                            PyTuple_GET_ITEM(key, 1));
+            if (!entry || PyList_Append(list, entry) < 0)
+                Py_CLEAR(list);
+            Py_XDECREF(entry);
+        }
+        Py_DECREF(sites);
+        if (!list || PyList_Sort(list) < 0 || PyList_Reverse(list) < 0) {
+            Py_XDECREF(list);
+            return NULL;
+        }
+
+        // Sorted on (count, filename, lineno), now reorder to (filename, lineno, count)
+        Py_ssize_t size = PyList_GET_SIZE(list) < top ? PyList_GET_SIZE(list) : top;
+        sites = PyList_New(size);
+        for (Py_ssize_t i = 0; i < size; i++) {
+            PyObject *entry = PyList_GET_ITEM(list, i);
+            PyList_SET_ITEM(sites, i, Py_BuildValue("(OOO)", PyTuple_GET_ITEM(entry, 1),
+                                                    PyTuple_GET_ITEM(entry, 2),
+                                                    PyTuple_GET_ITEM(entry, 0)));
+        }
+        Py_DECREF(list);
+    }
+
+    return Py_BuildValue("{s:n,s:n,s:n,s:N}", "live", (Py_ssize_t)live, "created", (Py_ssize_t)total,
+                         "objects", (Py_ssize_t)objects, "sites", sites);
+}
+
+
+
 // Comparison predicates
 
 #define COMPARE(pred)                                                   \
@@ -425,13 +955,31 @@ TYPECHECK(functionp)
 
 PyMethodDef methods[] = {
     METHOD(intern, METH_VARARGS),
+    METHOD(intern_soft, METH_VARARGS),
+    METHOD(find_symbols, METH_VARARGS),
     METHOD(str, METH_VARARGS),
     METHOD(int, METH_VARARGS),
+    METHOD(small_int_range, METH_VARARGS),
     METHOD(float, METH_VARARGS),
     METHOD(function, METH_VARARGS | METH_KEYWORDS),
+    METHOD(autoload, METH_VARARGS | METH_KEYWORDS),
+    METHOD(convert, METH_VARARGS | METH_KEYWORDS),
     METHOD(cons, METH_VARARGS),
     METHOD(list, METH_VARARGS),
     METHOD(vector, METH_VARARGS),
+    METHOD(batch, METH_VARARGS),
+    METHOD(byte_compile, METH_VARARGS),
+    METHOD(handle, METH_VARARGS),
+    METHOD(unwrap, METH_VARARGS),
+    METHOD(diff, METH_VARARGS | METH_KEYWORDS),
+    METHOD(add_text_properties, METH_VARARGS | METH_KEYWORDS),
+    METHOD(make_overlays, METH_VARARGS | METH_KEYWORDS),
+    METHOD(sort, METH_VARARGS | METH_KEYWORDS),
+    METHOD(to_array, METH_VARARGS | METH_KEYWORDS),
+    METHOD(arithmetic_result, METH_VARARGS),
+    METHOD(startup_times, METH_NOARGS),
+    METHOD(track_refs, METH_VARARGS | METH_KEYWORDS),
+    METHOD(ref_stats, METH_VARARGS | METH_KEYWORDS),
     METHOD(eq, METH_VARARGS),
     METHOD(eql, METH_VARARGS),
     METHOD(equal, METH_VARARGS),
@@ -488,6 +1036,13 @@ PyObject *PyInit_emacs_raw()
     Py_INCREF(&EmacsObjectType);
     PyModule_AddObject(mod, "EmacsObject", (PyObject *)&EmacsObjectType);
 
+    if (PyType_Ready(&BatchType) < 0 || PyType_Ready(&BatchResultType) < 0)
+        return NULL;
+    Py_INCREF(&BatchType);
+    PyModule_AddObject(mod, "Batch", (PyObject *)&BatchType);
+    Py_INCREF(&BatchResultType);
+    PyModule_AddObject(mod, "BatchResult", (PyObject *)&BatchResultType);
+
     EmacsSignal = PyErr_NewExceptionWithDoc("emacs_raw.Signal", __doc_EmacsSignal, NULL, NULL);
     Py_INCREF(EmacsSignal);
     PyModule_AddObject(mod, "Signal", EmacsSignal);
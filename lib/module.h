@@ -4,17 +4,47 @@
 #define MODULE_H
 
 
+/**
+ * \brief Data pointer for Emacs function objects that call Python.
+ */
+typedef struct {
+    PyObject *function;
+    bool raw;
+    bool handles;
+    int returns;
+} Callback;
+
+/**
+ * \brief Create a callback record for use with call_function.
+ *
+ * Arguments are not checked for handles unless the handles field is set.
+ * \param function The Python callable (a new reference is taken).
+ * \param raw If true, arguments are passed as environment-local objects.
+ * \param returns CONVERT_ flags used for converting the return value.
+ */
+Callback *Callback__new(PyObject *function, bool raw, int returns);
+
 /**
  * \brief Entry point for calling Python functions from Emacs.
  *
  * This function can be used as a callback when creating an Emacs function
  * object with em_function. It will wrap all the arguments as Python objects, and
- * then call the Python callable pointed to by the data pointer, catching all
- * errors and converting them to Emacs non-local exit signals as appropriate.
- * The return value must be an Emacs object or None (which is converted to nil).
+ * then call the Python callable in the Callback pointed to by the data pointer,
+ * catching all errors and converting them to Emacs non-local exit signals as
+ * appropriate. The return value must be convertible to an Emacs object (see
+ * EmacsObject__convert) using the flags of the callback.
+ *
+ * If the callback is raw, the arguments are not pinned with global references.
+ * Arguments that are still referenced from Python when the call returns are
+ * pinned at that point.
  */
 emacs_value call_function(emacs_env *env, ptrdiff_t nargs, emacs_value *args, void *data);
 
+/**
+ * \brief Record the time spent in a phase of startup, for startup_times().
+ */
+void record_startup_phase(const char *phase, double seconds);
+
 PyObject *PyInit_emacs_raw();
 PyTypeObject EmacsObjectType;
 extern PyObject *EmacsThrow, *EmacsSignal;
@@ -1,4 +1,6 @@
 #include <Python.h>
+#include <frameobject.h>
+#include <math.h>
 
 #include "emacs-interface.h"
 #include "error.h"
@@ -8,28 +10,458 @@
 
 
 
+// Reference accounting
+
+static size_t __live_refs = 0;
+static PyObject *__ref_sites = NULL;
+
+void EmacsObject__track_sites(bool enable)
+{
+    if (enable && !__ref_sites)
+        __ref_sites = PyDict_New();
+    else if (!enable)
+        Py_CLEAR(__ref_sites);
+}
+
+PyObject *EmacsObject__ref_stats(size_t *live)
+{
+    *live = __live_refs;
+    if (!__ref_sites)
+        Py_RETURN_NONE;
+    return PyDict_Copy(__ref_sites);
+}
+
+static PyObject *EmacsObject__current_site()
+{
+    PyFrameObject *frame = PyEval_GetFrame();
+    if (!frame)
+        return Py_BuildValue("(si)", "<emacs>", 0);
+
+#if PY_VERSION_HEX >= 0x03090000
+    PyCodeObject *code = PyFrame_GetCode(frame);
+    PyObject *site = Py_BuildValue("(Oi)", code->co_filename, PyFrame_GetLineNumber(frame));
+    Py_DECREF(code);
+    return site;
+#else
+    return Py_BuildValue("(Oi)", frame->f_code->co_filename, PyFrame_GetLineNumber(frame));
+#endif
+}
+
+static void EmacsObject__pin(EmacsObject *self)
+{
+    self->val = em_make_global(self->val);
+    self->global = true;
+    __live_refs++;
+
+    if (!__ref_sites)
+        return;
+    PyObject *site = EmacsObject__current_site();
+    if (!site) {
+        PyErr_Clear();
+        return;
+    }
+    PyObject *count = PyDict_GetItem(__ref_sites, site);
+    PyObject *new_count = PyLong_FromSsize_t((count ? PyLong_AsSsize_t(count) : 0) + 1);
+    PyDict_SetItem(__ref_sites, site, new_count);
+    Py_DECREF(new_count);
+    self->site = site;
+}
+
+static void EmacsObject__unpin(EmacsObject *self)
+{
+    em_free_global(self->val);
+    self->global = false;
+    __live_refs--;
+
+    if (!self->site)
+        return;
+    PyObject *count = __ref_sites ? PyDict_GetItem(__ref_sites, self->site) : NULL;
+    if (count) {
+        Py_ssize_t remaining = PyLong_AsSsize_t(count) - 1;
+        if (remaining > 0) {
+            PyObject *new_count = PyLong_FromSsize_t(remaining);
+            PyDict_SetItem(__ref_sites, self->site, new_count);
+            Py_DECREF(new_count);
+        }
+        else
+            PyDict_DelItem(__ref_sites, self->site);
+    }
+    Py_CLEAR(self->site);
+}
+
+
+
+// Integers
+
+// Integers that don't fit in a machine word are copied limb by limb between
+// Python and Emacs bignums, via little-endian byte arrays
+
+#if defined(EMACS_MAJOR_VERSION) && EMACS_MAJOR_VERSION >= 27
+#if PY_VERSION_HEX >= 0x030D0000
+#define AS_BYTE_ARRAY(v, bytes, n) _PyLong_AsByteArray(v, bytes, n, 1, 0, 1)
+#else
+#define AS_BYTE_ARRAY(v, bytes, n) _PyLong_AsByteArray(v, bytes, n, 1, 0)
+#endif
+#endif
+
+bool EmacsObject__int(PyObject *arg, emacs_value *ret)
+{
+    int overflow;
+    long long val = PyLong_AsLongLongAndOverflow(arg, &overflow);
+    if (PyErr_Occurred())
+        return false;
+    if (!overflow) {
+        PyObject *shared = EmacsObject__small_int(val);
+        if (!shared && PyErr_Occurred())
+            return false;
+        *ret = shared ? ((EmacsObject *)shared)->val : em_int(val);
+        Py_XDECREF(shared);
+        return true;
+    }
+
+#if defined(EMACS_MAJOR_VERSION) && EMACS_MAJOR_VERSION >= 27
+    PyObject *magnitude = PyNumber_Absolute(arg);
+    if (!magnitude)
+        return false;
+
+    size_t nbytes = (_PyLong_NumBits(magnitude) + 7) / 8;
+    size_t nlimbs = (nbytes + sizeof(emacs_limb_t) - 1) / sizeof(emacs_limb_t);
+    unsigned char *bytes = (unsigned char *)calloc(nlimbs, sizeof(emacs_limb_t));
+    emacs_limb_t *limbs = (emacs_limb_t *)malloc(nlimbs * sizeof(emacs_limb_t));
+
+    bool success = AS_BYTE_ARRAY((PyLongObject *)magnitude, bytes, nbytes) == 0;
+    Py_DECREF(magnitude);
+
+    if (success) {
+        for (size_t i = 0; i < nlimbs; i++) {
+            emacs_limb_t limb = 0;
+            for (size_t j = sizeof(emacs_limb_t); j > 0; j--)
+                limb = (limb << 8) | bytes[i * sizeof(emacs_limb_t) + j - 1];
+            limbs[i] = limb;
+        }
+        *ret = em_big_int(overflow, Py_SAFE_DOWNCAST(nlimbs, size_t, ptrdiff_t), limbs);
+        if (!*ret) {
+            PyErr_SetString(PyExc_OverflowError, "Integer too large for this Emacs");
+            success = false;
+        }
+    }
+
+    free(bytes);
+    free(limbs);
+    return success;
+#else
+    PyErr_SetString(PyExc_OverflowError, "Integer too large for this Emacs");
+    return false;
+#endif
+}
+
+PyObject *EmacsObject__pylong(emacs_value val)
+{
+    intmax_t integer;
+    if (em_extract_int_exact(val, &integer))
+        return PyLong_FromLongLong(integer);
+
+#if defined(EMACS_MAJOR_VERSION) && EMACS_MAJOR_VERSION >= 27
+    int sign;
+    ptrdiff_t nlimbs = 0;
+    if (em_extract_big_int(val, &sign, &nlimbs, NULL)) {
+        emacs_limb_t *limbs = (emacs_limb_t *)malloc(nlimbs * sizeof(emacs_limb_t));
+        unsigned char *bytes = (unsigned char *)malloc(nlimbs * sizeof(emacs_limb_t));
+        em_extract_big_int(val, &sign, &nlimbs, limbs);
+
+        for (ptrdiff_t i = 0; i < nlimbs; i++) {
+            emacs_limb_t limb = limbs[i];
+            for (size_t j = 0; j < sizeof(emacs_limb_t); j++, limb >>= 8)
+                bytes[i * sizeof(emacs_limb_t) + j] = (unsigned char)(limb & 0xff);
+        }
+
+        PyObject *ret = _PyLong_FromByteArray(bytes, nlimbs * sizeof(emacs_limb_t), 1, 0);
+        free(limbs);
+        free(bytes);
+
+        if (ret && sign < 0) {
+            PyObject *neg = PyNumber_Negative(ret);
+            Py_DECREF(ret);
+            ret = neg;
+        }
+        return ret;
+    }
+#endif
+
+    PyErr_SetString(PyExc_OverflowError, "Integer too large for this Emacs");
+    return NULL;
+}
+
+#undef AS_BYTE_ARRAY
+
+
+
+// Strings
+
+bool EmacsObject__string(PyObject *arg, emacs_value *ret)
+{
+#if PY_VERSION_HEX < 0x030C0000
+    if (PyUnicode_READY(arg) < 0)
+        return false;
+#endif
+
+    // Compact ASCII strings store their text as-is, so it can be handed to
+    // Emacs without encoding it first
+    if (PyUnicode_IS_ASCII(arg)) {
+        *ret = em_ascii_strn((const char *)PyUnicode_DATA(arg), PyUnicode_GET_LENGTH(arg));
+        return true;
+    }
+
+    Py_ssize_t len;
+    const char *str = PyUnicode_AsUTF8AndSize(arg, &len);
+    if (!str)
+        return false;
+    *ret = em_strn(str, len);
+    return true;
+}
+
+PyObject *EmacsObject__pystring(emacs_value val)
+{
+    ptrdiff_t len;
+    char *str = em_extract_strn(val, &len);
+    PyObject *ret = PyUnicode_DecodeUTF8(str, len, NULL);
+    free(str);
+    return ret;
+}
+
+
+
 // Construction and destruction
 
 PyObject *EmacsObject__make(PyTypeObject *type, emacs_value val)
 {
     EmacsObject *self = (EmacsObject *)type->tp_alloc(type, 0);
-    if (self)
-        self->val = em_make_global(val);
+    if (self) {
+        self->val = val;
+        self->hash = -1;
+        EmacsObject__pin(self);
+    }
     return (PyObject *)self;
 }
 
-bool EmacsObject__coerce(PyObject *arg, bool prefer_symbol, emacs_value *ret)
+PyObject *EmacsObject__make_local(PyTypeObject *type, emacs_value val)
+{
+    EmacsObject *self = (EmacsObject *)type->tp_alloc(type, 0);
+    if (self) {
+        self->val = val;
+        self->global = false;
+        self->hash = -1;
+    }
+    return (PyObject *)self;
+}
+
+void EmacsObject__promote(EmacsObject *self)
+{
+    if (!self->global)
+        EmacsObject__pin(self);
+}
+
+
+
+// Shared objects
+//
+// Like CPython's small integers, nil, t and integers in a small range are
+// wrapped once and shared for the lifetime of the interpreter. They are
+// created on first use, and handing them out doesn't call Emacs. Only call
+// sites that already know the value return them, so that wrapping an
+// arbitrary value never has to compare it against nil and t.
+
+static PyObject *__nil = NULL, *__t = NULL;
+
+static PyObject **__small_ints = NULL;
+static intmax_t __small_int_low = -5, __small_int_high = 256;
+
+PyObject *EmacsObject__nil()
+{
+    if (!__nil && !(__nil = EmacsObject__make(&EmacsObjectType, em__nil)))
+        return NULL;
+    Py_INCREF(__nil);
+    return __nil;
+}
+
+PyObject *EmacsObject__t()
 {
-    if (PyObject_TypeCheck(arg, &EmacsObjectType))
+    if (!__t && !(__t = EmacsObject__make(&EmacsObjectType, em__t)))
+        return NULL;
+    Py_INCREF(__t);
+    return __t;
+}
+
+PyObject *EmacsObject__small_int(intmax_t i)
+{
+    if (i < __small_int_low || i > __small_int_high)
+        return NULL;
+    if (!__small_ints) {
+        __small_ints = (PyObject **)calloc(__small_int_high - __small_int_low + 1, sizeof(PyObject *));
+        if (!__small_ints)
+            return PyErr_NoMemory();
+    }
+
+    PyObject **entry = &__small_ints[i - __small_int_low];
+    if (!*entry && !(*entry = EmacsObject__make(&EmacsObjectType, em_int(i))))
+        return NULL;
+    Py_INCREF(*entry);
+    return *entry;
+}
+
+void EmacsObject__small_int_range(intmax_t *low, intmax_t *high, bool set)
+{
+    intmax_t prev_low = __small_int_low, prev_high = __small_int_high;
+    if (set && (*low != prev_low || *high != prev_high)) {
+        if (__small_ints) {
+            for (intmax_t i = 0; i <= prev_high - prev_low; i++)
+                Py_XDECREF(__small_ints[i]);
+            free(__small_ints);
+            __small_ints = NULL;
+        }
+        __small_int_low = *low;
+        __small_int_high = *high;
+    }
+    *low = prev_low;
+    *high = prev_high;
+}
+
+
+
+
+// Handles
+//
+// Python objects are handed to Emacs as user pointers owning a reference, and
+// recognized by their finalizer when they come back.
+
+static void EmacsObject__free_handle(void *ptr)
+{
+    PyGILState_STATE state = PyGILState_Ensure();
+    Py_DECREF((PyObject *)ptr);
+    PyGILState_Release(state);
+}
+
+// The object may own Emacs values, so it's only released with an environment
+static void EmacsObject__release_handle(void *ptr)
+{
+    em_defer(EmacsObject__free_handle, ptr);
+}
+
+emacs_value EmacsObject__handle(PyObject *obj)
+{
+    Py_INCREF(obj);
+    emacs_value ret = em_user_ptr(EmacsObject__release_handle, obj);
+    if (!ret)
+        Py_DECREF(obj);
+    return ret;
+}
+
+PyObject *EmacsObject__unwrap(emacs_value val)
+{
+    if (!em_type_is(val, em__user_ptr))
+        return NULL;
+    em_finalizer fin = NULL;
+    PyObject *obj = (PyObject *)em_get_user_ptr(val, &fin);
+    if (fin != EmacsObject__release_handle)
+        return NULL;
+    Py_INCREF(obj);
+    return obj;
+}
+
+
+
+static bool EmacsObject__convert_sequence(PyObject *arg, int flags, emacs_value *ret)
+{
+    PyObject *seq = PySequence_Fast(arg, "Expected a sequence");
+    if (!seq)
+        return false;
+
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(seq);
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+
+    emacs_value stack[32];
+    emacs_value *values = size <= 32 ? stack : (emacs_value *)malloc(size * sizeof(emacs_value));
+
+    bool success = true;
+    for (Py_ssize_t i = 0; i < size && success; i++)
+        success = EmacsObject__convert(items[i], flags, &values[i]);
+
+    if (success) {
+        emacs_value func = (flags & CONVERT_VECTOR) ? em__vector : em__list;
+        *ret = em_funcall(func, Py_SAFE_DOWNCAST(size, Py_ssize_t, int), values);
+    }
+
+    if (values != stack)
+        free(values);
+    Py_DECREF(seq);
+    return success;
+}
+
+static bool EmacsObject__convert_dict(PyObject *arg, int flags, emacs_value *ret)
+{
+    int key_flags = (flags & CONVERT_SYMBOL_KEYS) ? (flags | CONVERT_SYMBOL) : flags;
+    Py_ssize_t ppos = 0;
+    PyObject *key, *value;
+    emacs_value ekey, evalue;
+
+    if (flags & CONVERT_HASH_TABLE) {
+        emacs_value args[] = {em__kw_test, em__equal, em__kw_size, em_int(PyDict_Size(arg))};
+        emacs_value table = em_funcall(em__make_hash_table, 4, args);
+        while (PyDict_Next(arg, &ppos, &key, &value)) {
+            if (!EmacsObject__convert(key, key_flags, &ekey)
+                || !EmacsObject__convert(value, flags, &evalue))
+                return false;
+            em_funcall_3(em__puthash, ekey, evalue, table);
+        }
+        *ret = table;
+        return true;
+    }
+
+    // Build the alist front to back so that it preserves the dict ordering
+    emacs_value head = em__nil, tail = NULL;
+    while (PyDict_Next(arg, &ppos, &key, &value)) {
+        if (!EmacsObject__convert(key, key_flags, &ekey)
+            || !EmacsObject__convert(value, flags, &evalue))
+            return false;
+        emacs_value cell = em_cons(em_cons(ekey, evalue), em__nil);
+        if (tail)
+            em_setcdr(tail, cell);
+        else
+            head = cell;
+        tail = cell;
+    }
+    *ret = head;
+    return true;
+}
+
+bool EmacsObject__convert(PyObject *arg, int flags, emacs_value *ret)
+{
+    if (PyObject_TypeCheck(arg, &EmacsObjectType)) {
         *ret = ((EmacsObject *)arg)->val;
-    else if (PyObject_HasAttrString(arg, "__emacs__")) {
+        return true;
+    }
+    else if (arg == Py_None || arg == Py_False) {
+        *ret = em__nil;
+        return true;
+    }
+    else if (arg == Py_True) {
+        *ret = em__t;
+        return true;
+    }
+
+    // Builtin types can't have an __emacs__ method, so don't go looking for one
+    bool builtin = PyLong_CheckExact(arg) || PyFloat_CheckExact(arg) || PyUnicode_CheckExact(arg)
+        || PyTuple_CheckExact(arg) || PyList_CheckExact(arg) || PyDict_CheckExact(arg);
+
+    if (!builtin && PyObject_HasAttrString(arg, "__emacs__")) {
         PyObject *args = PyTuple_New(0);
         PyObject *kwargs = PyDict_New();
-        PyDict_SetItemString(kwargs, "prefer_symbol", prefer_symbol ? Py_True : Py_False);
+        PyDict_SetItemString(kwargs, "prefer_symbol",
+                             (flags & CONVERT_SYMBOL) ? Py_True : Py_False);
 
         PyObject *method = PyObject_GetAttrString(arg, "__emacs__");
-        PyObject *pyret = PyObject_Call(PyObject_GetAttrString(arg, "__emacs__"), args, kwargs);
-        Py_DECREF(args); Py_DECREF(kwargs); Py_DECREF(method);
+        PyObject *pyret = method ? PyObject_Call(method, args, kwargs) : NULL;
+        Py_DECREF(args); Py_DECREF(kwargs); Py_XDECREF(method);
 
         if (!pyret || !PyObject_TypeCheck(pyret, &EmacsObjectType)) {
             Py_XDECREF(pyret);
@@ -39,16 +471,9 @@ bool EmacsObject__coerce(PyObject *arg, bool prefer_symbol, emacs_value *ret)
         *ret = ((EmacsObject *)pyret)->val;
         Py_DECREF(pyret);
     }
-    else if (arg == Py_None || arg == Py_False)
-        *ret = em__nil;
-    else if (arg == Py_True)
-        *ret = em__t;
     else if (PyLong_Check(arg)) {
-        int overflow;
-        intmax_t val = PyLong_AsLongLongAndOverflow(arg, &overflow);
-        if (PyErr_Occurred() || overflow)
+        if (!EmacsObject__int(arg, ret))
             return false;
-        *ret = em_int(val);
     }
     else if (PyFloat_Check(arg)) {
         double val = PyFloat_AsDouble(arg);
@@ -57,42 +482,30 @@ bool EmacsObject__coerce(PyObject *arg, bool prefer_symbol, emacs_value *ret)
         *ret = em_float(val);
     }
     else if (PyUnicode_Check(arg)) {
-        char *val = PyUnicode_AsUTF8(arg);
+        if (!(flags & CONVERT_SYMBOL))
+            return EmacsObject__string(arg, ret);
+        const char *val = PyUnicode_AsUTF8(arg);
         if (!val)
             return false;
-        if (prefer_symbol)
-            *ret = em_intern(val);
-        else
-            *ret = em_str(val);
-    }
-    else if (PyTuple_Check(arg)) {
-        int size = Py_SAFE_DOWNCAST(PyTuple_Size(arg), Py_ssize_t, int);
-        emacs_value items[size];
-        for (int i = 0; i < size; i++) {
-            if (!EmacsObject__coerce(PyTuple_GetItem(arg, i), prefer_symbol, &items[i]))
-                return false;
-        }
-        *ret = em_funcall(em__list, size, items);
-    }
-    else if (PyList_Check(arg)) {
-        int size = Py_SAFE_DOWNCAST(PyList_Size(arg), Py_ssize_t, int);
-        emacs_value items[size];
-        for (int i = 0; i < size; i++) {
-            if (!EmacsObject__coerce(PyList_GetItem(arg, i), prefer_symbol, &items[i]))
-                return false;
-        }
-        *ret = em_funcall(em__list, size, items);
+        *ret = em_intern(val);
     }
+    else if (PyTuple_Check(arg) || PyList_Check(arg))
+        return EmacsObject__convert_sequence(arg, flags, ret);
+    else if (PyDict_Check(arg) && (flags & (CONVERT_ALIST | CONVERT_HASH_TABLE)))
+        return EmacsObject__convert_dict(arg, flags, ret);
     else if (PyCallable_Check(arg)) {
         PyObject *pydoc = PyObject_GetAttrString(arg, "__doc__");
-        char *doc = NULL;
+        const char *doc = NULL;
         if (pydoc && PyUnicode_Check(pydoc)) {
             if (!(doc = PyUnicode_AsUTF8(pydoc)))
                 PyErr_Clear();
         }
+        else if (!pydoc)
+            PyErr_Clear();
 
-        Py_INCREF(arg);
-        *ret = em_function(call_function, 0, emacs_variadic_function, doc, arg);
+        *ret = em_function(call_function, 0, emacs_variadic_function, doc,
+                           Callback__new(arg, false, 0));
+        Py_XDECREF(pydoc);
     }
     else
         return false;
@@ -100,6 +513,54 @@ bool EmacsObject__coerce(PyObject *arg, bool prefer_symbol, emacs_value *ret)
     return true;
 }
 
+bool EmacsObject__coerce(PyObject *arg, bool prefer_symbol, emacs_value *ret)
+{
+    return EmacsObject__convert(arg, prefer_symbol ? CONVERT_SYMBOL : 0, ret);
+}
+
+bool EmacsObject__parse_shape(PyObject *spec, int *flags)
+{
+    static const struct {
+        const char *name;
+        int flag;
+    } shapes[] = {
+        {"list", 0},
+        {"symbol", CONVERT_SYMBOL},
+        {"vector", CONVERT_VECTOR},
+        {"alist", CONVERT_ALIST},
+        {"hash-table", CONVERT_HASH_TABLE},
+        {"symbol-keys", CONVERT_SYMBOL_KEYS},
+    };
+
+    *flags = 0;
+    if (!spec || spec == Py_None)
+        return true;
+
+    PyObject *seq = PyUnicode_Check(spec) ? PyTuple_Pack(1, spec)
+        : PySequence_Fast(spec, "Shape must be a string or a sequence of strings");
+    if (!seq)
+        return false;
+
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+        const char *name = PyUnicode_Check(item) ? PyUnicode_AsUTF8(item) : NULL;
+        size_t j;
+        for (j = 0; name && j < sizeof(shapes) / sizeof(shapes[0]); j++)
+            if (!strcmp(name, shapes[j].name))
+                break;
+        if (!name || j == sizeof(shapes) / sizeof(shapes[0])) {
+            if (!PyErr_Occurred())
+                PyErr_Format(PyExc_ValueError, "Unknown shape: %R", item);
+            Py_DECREF(seq);
+            return false;
+        }
+        *flags |= shapes[j].flag;
+    }
+
+    Py_DECREF(seq);
+    return true;
+}
+
 DOCSTRING(EmacsObject,
           "EmacsObject(obj, prefer_symbol=False, require_symbol=False)\n\n"
           "Creates an Emacs lisp object from `obj`, according to the following rules.\n\n"
@@ -128,7 +589,7 @@ DOCSTRING(EmacsObject,
 PyObject *EmacsObject_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
     if (PyTuple_Size(args) == 0)
-        return EmacsObject__make(type, em_intern("nil"));
+        return type == &EmacsObjectType ? EmacsObject__nil() : EmacsObject__make(type, em__nil);
     PyObject *arg;
     int prefer_symbol = false, require_symbol = false;
     char *keywords[] = {"obj", "prefer_symbol", "require_symbol", NULL};
@@ -137,6 +598,11 @@ PyObject *EmacsObject_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         return NULL;
     prefer_symbol |= require_symbol;
 
+    if (type == &EmacsObjectType && (arg == Py_None || arg == Py_False))
+        return EmacsObject__nil();
+    if (type == &EmacsObjectType && arg == Py_True)
+        return EmacsObject__t();
+
     emacs_value coerced;
     if (!EmacsObject__coerce(arg, prefer_symbol, &coerced)) {
         if (!PyErr_Occurred())
@@ -154,17 +620,68 @@ PyObject *EmacsObject_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 
 void EmacsObject_dealloc(EmacsObject *self)
 {
-    em_free_global(self->val);
+    if (self->global)
+        EmacsObject__unpin(self);
+    Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
 
 
 // Python Object protocol
 
+// Symbols are printed very often (type names, keywords, str() of symbols in
+// Python code), so their printed forms are kept in a small cache, looked up
+// with eq. The strings are interned, so equal strings from the cache are
+// also identical.
+
+#define SYMBOL_CACHE_SIZE 64
+
+static struct {
+    emacs_value symbol;
+    PyObject *str;
+} __symbol_cache[SYMBOL_CACHE_SIZE];
+static size_t __symbol_cache_next = 0;
+
+static PyObject *EmacsObject__symbol_str(emacs_value symbol)
+{
+    for (size_t i = 0; i < SYMBOL_CACHE_SIZE && __symbol_cache[i].symbol; i++) {
+        if (em_eq(__symbol_cache[i].symbol, symbol)) {
+            Py_INCREF(__symbol_cache[i].str);
+            return __symbol_cache[i].str;
+        }
+    }
+
+    char *name = em_print_obj(symbol);
+    PyObject *str = PyUnicode_FromString(name);
+    free(name);
+    if (!str)
+        return NULL;
+    PyUnicode_InternInPlace(&str);
+
+    size_t i = __symbol_cache_next;
+    __symbol_cache_next = (__symbol_cache_next + 1) % SYMBOL_CACHE_SIZE;
+    if (__symbol_cache[i].symbol) {
+        em_free_global(__symbol_cache[i].symbol);
+        Py_DECREF(__symbol_cache[i].str);
+    }
+    __symbol_cache[i].symbol = em_make_global(symbol);
+    __symbol_cache[i].str = str;
+
+    Py_INCREF(str);
+    return str;
+}
+
+#undef SYMBOL_CACHE_SIZE
+
 PyObject *EmacsObject_str(PyObject *self)
 {
     emacs_value obj = ((EmacsObject *)self)->val;
-    char *str = em_stringp(obj) ? em_extract_str(obj) : em_print_obj(obj);
+    emacs_value type = em_type(obj);
+    if (em_eq(type, em__symbol))
+        return EmacsObject__symbol_str(obj);
+    if (em_eq(type, em__string))
+        return EmacsObject__pystring(obj);
+    char *str = em_print_obj(obj);
     PyObject *ret = PyUnicode_FromString(str);
     free(str);
     return ret;
@@ -173,6 +690,8 @@ PyObject *EmacsObject_str(PyObject *self)
 PyObject *EmacsObject_repr(PyObject *self)
 {
     emacs_value obj = ((EmacsObject *)self)->val;
+    if (em_symbolp(obj))
+        return EmacsObject__symbol_str(obj);
     char *str = em_print_obj(obj);
     PyObject *ret = PyUnicode_FromString(str);
     free(str);
@@ -188,11 +707,8 @@ int EmacsObject_bool(PyObject *self)
 PyObject *EmacsObject_int(PyObject *self)
 {
     emacs_value val = ((EmacsObject *)self)->val;
-    if (em_integerp(val)) {
-        intmax_t integer = em_extract_int(val);
-        Py_ssize_t pyint = Py_SAFE_DOWNCAST(integer, intmax_t, Py_ssize_t);
-        return PyLong_FromSsize_t(pyint);
-    }
+    if (em_integerp(val))
+        return EmacsObject__pylong(val);
     else if (em_floatp(val)) {
         double dbl = em_extract_float(val);
         return PyLong_FromDouble(dbl);
@@ -211,17 +727,19 @@ PyObject *EmacsObject_float(PyObject *self)
 {
     emacs_value val = ((EmacsObject *)self)->val;
     if (em_integerp(val)) {
-        intmax_t integer = em_extract_int(val);
-        return PyFloat_FromDouble((double)integer);
+        PyObject *integer = EmacsObject__pylong(val);
+        if (!integer)
+            return NULL;
+        PyObject *ret = PyNumber_Float(integer);
+        Py_DECREF(integer);
+        return ret;
     }
     else if (em_floatp(val)) {
         double dbl = em_extract_float(val);
         return PyFloat_FromDouble(dbl);
     }
     else if (em_stringp(val)) {
-        char *str = em_extract_str(val);
-        PyObject *pystr = PyUnicode_FromString(str);
-        free(str);
+        PyObject *pystr = EmacsObject__pystring(val);
         if (pystr) {
             PyObject *ret = PyFloat_FromString(pystr);
             Py_DECREF(pystr);
@@ -277,75 +795,83 @@ PyObject *EmacsObject_call(PyObject *self, PyObject *args, PyObject *kwds)
     return EmacsObject__make(&EmacsObjectType, ret);
 }
 
-PyObject *EmacsObject_cmp(PyObject *pa, PyObject *pb, int op)
+// Equal objects must have equal hashes, also when compared to Python numbers
+// and strings, so those hash as their Python counterparts. Other objects use
+// sxhash-equal, except symbols, which are compared with eq and never change.
+Py_hash_t EmacsObject_hash(PyObject *self)
 {
-    emacs_value a = ((EmacsObject *)pa)->val;
-    emacs_value b = NULL;
-
-    if (em_numberp(a) && PyLong_Check(pb)) {
-        int overflow;
-        long long val = PyLong_AsLongLongAndOverflow(pb, &overflow);
-        if (PyErr_Occurred())
-            return NULL;
-        if (overflow)
-            Py_RETURN_FALSE;
-        b = em_int(val);
-    }
-    else if (em_numberp(a) && PyFloat_Check(pb)) {
-        double val = PyFloat_AsDouble(pb);
-        if (PyErr_Occurred())
-            return NULL;
-        b = em_float(val);
-    }
-    else if (em_stringp(a) && PyUnicode_Check(pb)) {
-        char *val = PyUnicode_AsUTF8(pb);
-        if (!val)
-            return NULL;
-        b = em_str(val);
-    }
-    else if (!PyObject_TypeCheck(pb, &EmacsObjectType)) {
-        if (op == Py_EQ)
-            Py_RETURN_FALSE;
-        else if (op == Py_NE)
-            Py_RETURN_TRUE;
-        else {
-            PyErr_SetString(PyExc_TypeError, "Unorderable types");
-            return NULL;
-        }
+    EmacsObject *obj = (EmacsObject *)self;
+    if (obj->hash != -1)
+        return obj->hash;
+
+    emacs_value val = obj->val;
+    emacs_value type = em_type(val);
+    bool number = em_eq(type, em__integer) || em_eq(type, em__float);
+
+    Py_hash_t hash;
+    if (number || em_eq(type, em__string)) {
+        PyObject *pyval;
+        if (em_eq(type, em__integer))
+            pyval = EmacsObject__pylong(val);
+        else if (em_eq(type, em__float))
+            pyval = PyFloat_FromDouble(em_extract_float(val));
+        else
+            pyval = EmacsObject__pystring(val);
+        if (!pyval)
+            return -1;
+        hash = PyObject_Hash(pyval);
+        Py_DECREF(pyval);
+        if (hash != -1 && number)
+            obj->hash = hash;
+        return hash;
     }
-    else
-        b = ((EmacsObject *)pb)->val;
-
-    bool error;
-    bool ret = em_compare(a, b, op, &error);
 
-    if (error) {
-        PyErr_SetString(PyExc_TypeError, "Unorderable types");
-        return NULL;
-    }
-    else if (ret)
-        Py_RETURN_TRUE;
-    Py_RETURN_FALSE;
+    bool symbol = em_eq(type, em__symbol);
+    emacs_value ehash = em_funcall_1(symbol ? em__sxhash_eq : em__sxhash_equal, val);
+    if (propagate_emacs_error())
+        return -1;
+    hash = (Py_hash_t)em_extract_int(ehash);
+    if (hash == -1)
+        hash = -2;
+    if (symbol)
+        obj->hash = hash;
+    return hash;
 }
 
+// The length of a list, or nil if it is improper, computed in the Lisp VM
+static emacs_value __list_length = NULL;
+
 Py_ssize_t EmacsObject_Size(PyObject *self)
 {
     emacs_value val = ((EmacsObject *)self)->val;
     intmax_t length = 0;
 
-    if (em_arrayp(val)) {
+    if (em_vectorp(val))
+        length = em_vec_size(val);
+    else if (em_arrayp(val)) {
         emacs_value elength = em_funcall_1(em__length, val);
         length = em_extract_int(elength);
     }
     else {
-        while (em_consp(val)) {
-            length++;
-            val = em_funcall_1(em__cdr, val);
+        if (!__list_length) {
+            emacs_value func = em_byte_compile(em_read(
+                "(lambda (list)"
+                "  (let ((n 0))"
+                "    (while (consp list) (setq n (1+ n) list (cdr list)))"
+                "    (and (null list) n)))"));
+            if (propagate_emacs_error())
+                return -1;
+            __list_length = em_make_global(func);
         }
-        if (em_truthy(val)) {
+
+        emacs_value elength = em_funcall_1(__list_length, val);
+        if (propagate_emacs_error())
+            return -1;
+        if (!em_truthy(elength)) {
             PyErr_SetString(PyExc_TypeError, "Improper Emacs sequence");
             return -1;
         }
+        length = em_extract_int(elength);
     }
 
     return Py_SAFE_DOWNCAST(length, intmax_t, Py_ssize_t);
@@ -355,6 +881,14 @@ PyObject *EmacsObject_GetItem(PyObject *self, Py_ssize_t i)
 {
     emacs_value val = ((EmacsObject *)self)->val;
 
+    if (em_vectorp(val)) {
+        if (i < 0 || i >= em_vec_size(val)) {
+            PyErr_SetString(PyExc_IndexError, "Index out of bounds");
+            return NULL;
+        }
+        return EmacsObject__make(&EmacsObjectType, em_vec_get(val, i));
+    }
+
     if (em_arrayp(val)) {
         if (i >= EmacsObject_Size(self)) {
             PyErr_SetString(PyExc_IndexError, "Index out of bounds");
@@ -374,7 +908,8 @@ PyObject *EmacsObject_GetItem(PyObject *self, Py_ssize_t i)
         return EmacsObject__make(&EmacsObjectType, obj);
     }
 
-    if ((i > 0 && em_consp(val)) || (i == 0 && !em_truthy(val))) {
+    // The walk reached the end of a proper list
+    if (!em_truthy(val)) {
         PyErr_SetString(PyExc_IndexError, "Index out of bounds");
         return NULL;
     }
@@ -383,112 +918,722 @@ PyObject *EmacsObject_GetItem(PyObject *self, Py_ssize_t i)
     return NULL;
 }
 
+int EmacsObject_SetItem(PyObject *self, Py_ssize_t i, PyObject *value)
+{
+    emacs_value val = ((EmacsObject *)self)->val, evalue;
+
+    if (!value) {
+        PyErr_SetString(PyExc_TypeError, "Emacs sequences don't support item deletion");
+        return -1;
+    }
+    if (!EmacsObject__coerce(value, false, &evalue)) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_TypeError, "Unable to coerce to Emacs Object");
+        return -1;
+    }
+
+    if (em_vectorp(val)) {
+        if (i < 0 || i >= em_vec_size(val)) {
+            PyErr_SetString(PyExc_IndexError, "Index out of bounds");
+            return -1;
+        }
+        em_vec_set(val, i, evalue);
+        return 0;
+    }
+
+    if (em_arrayp(val)) {
+        if (i >= EmacsObject_Size(self)) {
+            PyErr_SetString(PyExc_IndexError, "Index out of bounds");
+            return -1;
+        }
+        em_funcall_3(em__aset, val, em_int(i), evalue);
+        return propagate_emacs_error() ? -1 : 0;
+    }
+
+    while (em_consp(val) && i > 0) {
+        i--;
+        val = em_funcall_1(em__cdr, val);
+    }
+
+    if (i == 0 && em_consp(val)) {
+        em_setcar(val, evalue);
+        return 0;
+    }
+
+    // The walk reached the end of a proper list
+    if (!em_truthy(val)) {
+        PyErr_SetString(PyExc_IndexError, "Index out of bounds");
+        return -1;
+    }
+
+    PyErr_SetString(PyExc_TypeError, "Improper Emacs sequence");
+    return -1;
+}
+
 
 
-// Normalized operations
+// Arithmetic
+
+// Numeric operands are classified once, so that the common cases can be
+// computed natively without intermediate Python objects or Emacs calls
+typedef enum {
+    NUMBER_NONE,                // Not a number
+    NUMBER_INT,                 // An integer that fits in intmax_t
+    NUMBER_FLOAT,               // A float
+    NUMBER_BIG,                 // An integer that doesn't fit in intmax_t
+} NumberKind;
+
+typedef struct {
+    NumberKind kind;
+    intmax_t i;
+    double f;
+} Number;
+
+typedef enum {
+    OP_ADD, OP_SUBTRACT, OP_MULTIPLY, OP_REMAINDER, OP_FLOOR_DIVIDE,
+    OP_TRUE_DIVIDE, OP_LSHIFT, OP_RSHIFT, OP_POWER,
+    OP_NEGATIVE, OP_POSITIVE, OP_ABSOLUTE, OP_INVERT,
+} NumberOp;
+
+// If true, arithmetic results are Emacs numbers instead of Python numbers
+static bool __emacs_results = false;
+
+void EmacsObject__emacs_results(bool enable)
+{
+    __emacs_results = enable;
+}
 
+bool EmacsObject__emacs_results_p()
+{
+    return __emacs_results;
+}
+
+static NumberKind EmacsObject__number(PyObject *obj, Number *num)
+{
+    num->kind = NUMBER_NONE;
+
+    if (PyObject_TypeCheck(obj, &EmacsObjectType)) {
+        emacs_value val = ((EmacsObject *)obj)->val;
+        emacs_value type = em_type(val);
+        if (em_eq(type, em__integer))
+            num->kind = em_extract_int_exact(val, &num->i) ? NUMBER_INT : NUMBER_BIG;
+        else if (em_eq(type, em__float)) {
+            num->kind = NUMBER_FLOAT;
+            num->f = em_extract_float(val);
+        }
+    }
+    else if (PyLong_Check(obj)) {
+        int overflow;
+        long long i = PyLong_AsLongLongAndOverflow(obj, &overflow);
+        if (overflow || (i == -1 && PyErr_Occurred())) {
+            PyErr_Clear();
+            num->kind = NUMBER_BIG;
+        }
+        else {
+            num->kind = NUMBER_INT;
+            num->i = i;
+        }
+    }
+    else if (PyFloat_Check(obj)) {
+        num->kind = NUMBER_FLOAT;
+        num->f = PyFloat_AS_DOUBLE(obj);
+    }
+
+    return num->kind;
+}
+
+static inline double Number__double(Number *num)
+{
+    return num->kind == NUMBER_INT ? (double)num->i : num->f;
+}
+
+// Floored division and modulo of floats, as Python does it
+static void float_divmod(double a, double b, double *div, double *mod)
+{
+    double m = fmod(a, b);
+    double d = (a - m) / b;
+    if (m) {
+        if ((b < 0) != (m < 0)) {
+            m += b;
+            d -= 1.0;
+        }
+    }
+    else
+        m = copysign(0.0, b);
+
+    if (d) {
+        double f = floor(d);
+        if (d - f > 0.5)
+            f += 1.0;
+        d = f;
+    }
+    else
+        d = copysign(0.0, a / b);
+
+    *div = d;
+    *mod = m;
+}
+
+// Compute a binary operation on native numbers with Python semantics. Returns
+// false if the result can't be computed natively, e.g. on overflow, division
+// by zero, or if Python would raise an error.
+static bool Number__binary(NumberOp op, Number *a, Number *b, Number *r)
+{
+    if (a->kind == NUMBER_INT && b->kind == NUMBER_INT) {
+        intmax_t x = a->i, y = b->i;
+        r->kind = NUMBER_INT;
+
+        switch (op) {
+        case OP_ADD:
+            return !__builtin_add_overflow(x, y, &r->i);
+        case OP_SUBTRACT:
+            return !__builtin_sub_overflow(x, y, &r->i);
+        case OP_MULTIPLY:
+            return !__builtin_mul_overflow(x, y, &r->i);
+        case OP_REMAINDER:
+        case OP_FLOOR_DIVIDE:
+            if (y == 0 || (x == INTMAX_MIN && y == -1))
+                return false;
+            intmax_t div = x / y, mod = x % y;
+            if (mod && ((mod < 0) != (y < 0))) {
+                div--;
+                mod += y;
+            }
+            r->i = op == OP_REMAINDER ? mod : div;
+            return true;
+        case OP_TRUE_DIVIDE:
+            // Beyond 2^53 the conversion to double is inexact
+            if (y == 0 || x > (1LL << 53) || x < -(1LL << 53) || y > (1LL << 53) || y < -(1LL << 53))
+                return false;
+            r->kind = NUMBER_FLOAT;
+            r->f = (double)x / (double)y;
+            return true;
+        case OP_LSHIFT:
+            if (y < 0)
+                return false;
+            if (x == 0) {
+                r->i = 0;
+                return true;
+            }
+            if (y >= (intmax_t)(sizeof(intmax_t) * 8 - 1) || x > (INTMAX_MAX >> y) || x < (INTMAX_MIN >> y))
+                return false;
+            r->i = (intmax_t)((uintmax_t)x << y);
+            return true;
+        case OP_RSHIFT:
+            if (y < 0)
+                return false;
+            if (y >= (intmax_t)(sizeof(intmax_t) * 8))
+                r->i = x < 0 ? -1 : 0;
+            else
+                r->i = x >> y;
+            return true;
+        case OP_POWER: {
+            // Negative exponents produce floats in Python
+            if (y < 0)
+                return false;
+            intmax_t result = 1;
+            while (y) {
+                if ((y & 1) && __builtin_mul_overflow(result, x, &result))
+                    return false;
+                y >>= 1;
+                if (y && __builtin_mul_overflow(x, x, &x))
+                    return false;
+            }
+            r->i = result;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    if (!(a->kind == NUMBER_INT || a->kind == NUMBER_FLOAT) ||
+        !(b->kind == NUMBER_INT || b->kind == NUMBER_FLOAT))
+        return false;
+
+    double x = Number__double(a), y = Number__double(b), div, mod;
+    r->kind = NUMBER_FLOAT;
+
+    switch (op) {
+    case OP_ADD:
+        r->f = x + y;
+        return true;
+    case OP_SUBTRACT:
+        r->f = x - y;
+        return true;
+    case OP_MULTIPLY:
+        r->f = x * y;
+        return true;
+    case OP_TRUE_DIVIDE:
+        if (y == 0.0)
+            return false;
+        r->f = x / y;
+        return true;
+    case OP_REMAINDER:
+    case OP_FLOOR_DIVIDE:
+        if (y == 0.0)
+            return false;
+        float_divmod(x, y, &div, &mod);
+        r->f = op == OP_REMAINDER ? mod : div;
+        return true;
+    case OP_POWER:
+        // Leave complex results, division by zero and overflow to Python
+        if ((x < 0.0 && y != floor(y)) || (x == 0.0 && y < 0.0))
+            return false;
+        r->f = pow(x, y);
+        return !(isinf(r->f) && isfinite(x) && isfinite(y));
+    default:
+        return false;
+    }
+}
+
+static bool Number__unary(NumberOp op, Number *a, Number *r)
+{
+    r->kind = a->kind;
+    if (a->kind == NUMBER_INT) {
+        switch (op) {
+        case OP_NEGATIVE:
+        case OP_ABSOLUTE:
+            if (a->i == INTMAX_MIN)
+                return false;
+            r->i = (op == OP_NEGATIVE || a->i < 0) ? -a->i : a->i;
+            return true;
+        case OP_POSITIVE:
+            r->i = a->i;
+            return true;
+        case OP_INVERT:
+            r->i = ~a->i;
+            return true;
+        default:
+            return false;
+        }
+    }
+    else if (a->kind == NUMBER_FLOAT) {
+        switch (op) {
+        case OP_NEGATIVE:
+            r->f = -a->f;
+            return true;
+        case OP_POSITIVE:
+            r->f = a->f;
+            return true;
+        case OP_ABSOLUTE:
+            r->f = fabs(a->f);
+            return true;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+static PyObject *Number__result(Number *r)
+{
+    if (!__emacs_results)
+        return r->kind == NUMBER_INT ? PyLong_FromLongLong(r->i) : PyFloat_FromDouble(r->f);
+
+    emacs_value val = r->kind == NUMBER_INT ? em_int(r->i) : em_float(r->f);
+    if (propagate_emacs_error())
+        return NULL;
+    return EmacsObject__make(&EmacsObjectType, val);
+}
+
+// Convert an Emacs object to the closest Python type for the slow path
+// (returns a new reference)
 static PyObject *EmacsObject__normalize(PyObject *self)
 {
+    if (!PyObject_TypeCheck(self, &EmacsObjectType)) {
+        Py_INCREF(self);
+        return self;
+    }
+
     emacs_value val = ((EmacsObject *)self)->val;
+    emacs_value type = em_type(val);
 
-    PyObject *ret = NULL;
+    if (em_eq(type, em__integer))
+        return PyNumber_Long(self);
+    else if (em_eq(type, em__float))
+        return PyNumber_Float(self);
+    else if (em_eq(type, em__string))
+        return PyObject_Str(self);
 
-    if (em_integerp(val))
-        ret = PyNumber_Long(self);
-    else if (em_floatp(val))
-        ret = PyNumber_Float(self);
-    else if (em_stringp(val))
-        ret = PyObject_Str(self);
+    PyErr_SetString(PyExc_TypeError, "Unsupported operand types");
+    return NULL;
+}
 
-    Py_XINCREF(ret);
-    return ret;
+// Whether the Lisp function for an operation gives the same result as Python,
+// for operands that Number__binary or Number__unary declined. That is only the
+// case for integer results that don't fit in a machine word: everything else
+// (division by zero, negative shift counts, float results) follows Python.
+static bool Number__lisp_compatible(NumberOp op, Number *a, Number *b)
+{
+    bool integers = a->kind == NUMBER_INT || a->kind == NUMBER_BIG;
+    if (!b || !integers)
+        return integers;
+    if (b->kind != NUMBER_INT && b->kind != NUMBER_BIG)
+        return false;
+
+    switch (op) {
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+        return true;
+    case OP_REMAINDER:
+    case OP_FLOOR_DIVIDE:
+        return b->kind == NUMBER_BIG || b->i != 0;
+    case OP_LSHIFT:
+    case OP_RSHIFT:
+    case OP_POWER:
+        return b->kind == NUMBER_INT && b->i >= 0;
+    default:
+        return false;
+    }
+}
+
+// Results computed by Python are converted back to Emacs numbers if requested
+static PyObject *EmacsObject__python_result(PyObject *ret)
+{
+    if (!__emacs_results || !ret || !(PyLong_CheckExact(ret) || PyFloat_CheckExact(ret)))
+        return ret;
+    emacs_value val;
+    bool success = EmacsObject__coerce(ret, false, &val);
+    Py_DECREF(ret);
+    if (!success || propagate_emacs_error())
+        return NULL;
+    return EmacsObject__make(&EmacsObjectType, val);
+}
+
+// Compute a result with Lisp functions, so that it stays in Emacs
+static PyObject *EmacsObject__lisp_operation(NumberOp op, PyObject *pa, PyObject *pb)
+{
+    emacs_value a, b = NULL;
+    if (!EmacsObject__coerce(pa, false, &a) || (pb && !EmacsObject__coerce(pb, false, &b))) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_TypeError, "Unsupported operand types");
+        return NULL;
+    }
+
+    emacs_value ret;
+    switch (op) {
+    case OP_ADD: ret = em_funcall_2(em__add, a, b); break;
+    case OP_SUBTRACT: ret = em_funcall_2(em__subtract, a, b); break;
+    case OP_MULTIPLY: ret = em_funcall_2(em__multiply, a, b); break;
+    case OP_REMAINDER: ret = em_funcall_2(em__mod, a, b); break;
+    case OP_FLOOR_DIVIDE: ret = em_funcall_2(em__floor, a, b); break;
+    case OP_TRUE_DIVIDE: ret = em_funcall_2(em__divide, em_funcall_1(em__float, a), b); break;
+    case OP_LSHIFT: ret = em_funcall_2(em__ash, a, b); break;
+    case OP_RSHIFT: ret = em_funcall_2(em__ash, a, em_funcall_1(em__subtract, b)); break;
+    case OP_POWER: ret = em_funcall_2(em__expt, a, b); break;
+    case OP_NEGATIVE: ret = em_funcall_1(em__subtract, a); break;
+    case OP_POSITIVE: ret = a; break;
+    case OP_ABSOLUTE: ret = em_funcall_1(em__abs, a); break;
+    case OP_INVERT: ret = em_funcall_1(em__lognot, a); break;
+    default: ret = em__nil;
+    }
+
+    if (propagate_emacs_error())
+        return NULL;
+    return EmacsObject__make(&EmacsObjectType, ret);
+}
+
+static PyObject *EmacsObject__binary(NumberOp op, binaryfunc pyfunc, PyObject *pa, PyObject *pb)
+{
+    Number a, b, r;
+    NumberKind ka = EmacsObject__number(pa, &a);
+    NumberKind kb = EmacsObject__number(pb, &b);
+
+    if (ka != NUMBER_NONE && kb != NUMBER_NONE) {
+        if (Number__binary(op, &a, &b, &r))
+            return Number__result(&r);
+        if (__emacs_results && Number__lisp_compatible(op, &a, &b))
+            return EmacsObject__lisp_operation(op, pa, pb);
+    }
+
+    // Fall back to Python semantics, e.g. for strings
+    PyObject *na = EmacsObject__normalize(pa);
+    if (!na)
+        return NULL;
+    PyObject *nb = EmacsObject__normalize(pb);
+    if (!nb) {
+        Py_DECREF(na);
+        return NULL;
+    }
+
+    PyObject *ret = pyfunc(na, nb);
+    Py_DECREF(na);
+    Py_DECREF(nb);
+    return EmacsObject__python_result(ret);
+}
+
+static PyObject *EmacsObject__unary(NumberOp op, unaryfunc pyfunc, PyObject *pa)
+{
+    Number a, r;
+    if (EmacsObject__number(pa, &a) != NUMBER_NONE) {
+        if (Number__unary(op, &a, &r))
+            return Number__result(&r);
+        if (__emacs_results && Number__lisp_compatible(op, &a, NULL))
+            return EmacsObject__lisp_operation(op, pa, NULL);
+    }
+
+    PyObject *na = EmacsObject__normalize(pa);
+    if (!na)
+        return NULL;
+    PyObject *ret = pyfunc(na);
+    Py_DECREF(na);
+    return EmacsObject__python_result(ret);
 }
 
 PyObject *EmacsObject_power(PyObject *self, PyObject *other, PyObject *mod)
 {
-    PyObject *c_self = self, *c_other = other, *c_mod = mod;
+    if (mod == Py_None) {
+        Number a, b, r;
+        NumberKind ka = EmacsObject__number(self, &a);
+        NumberKind kb = EmacsObject__number(other, &b);
+
+        if (ka != NUMBER_NONE && kb != NUMBER_NONE) {
+            if (Number__binary(OP_POWER, &a, &b, &r))
+                return Number__result(&r);
+            if (__emacs_results && Number__lisp_compatible(OP_POWER, &a, &b))
+                return EmacsObject__lisp_operation(OP_POWER, self, other);
+        }
+    }
 
-    if (PyObject_TypeCheck(self, &EmacsObjectType))
-        c_self = EmacsObject__normalize(c_self);
-    if (PyObject_TypeCheck(other, &EmacsObjectType))
-        c_other = EmacsObject__normalize(c_other);
-    if (PyObject_TypeCheck(mod, &EmacsObjectType))
-        c_mod = EmacsObject__normalize(c_mod);
+    PyObject *c_self = EmacsObject__normalize(self);
+    PyObject *c_other = c_self ? EmacsObject__normalize(other) : NULL;
+    PyObject *c_mod = c_other ? EmacsObject__normalize(mod) : NULL;
 
     PyObject *ret = NULL;
-
-    if (c_self && c_other && c_mod)
+    if (c_mod)
         ret = PyNumber_Power(c_self, c_other, c_mod);
-    else
-        PyErr_SetString(PyExc_TypeError, "Unsupported operand types");
 
     Py_XDECREF(c_self);
     Py_XDECREF(c_other);
     Py_XDECREF(c_mod);
+    return EmacsObject__python_result(ret);
+}
+
+PyObject *EmacsObject_divmod(PyObject *self, PyObject *other)
+{
+    Number a, b, div, mod;
+    NumberKind ka = EmacsObject__number(self, &a);
+    NumberKind kb = EmacsObject__number(other, &b);
+
+    if (ka != NUMBER_NONE && kb != NUMBER_NONE) {
+        if (Number__binary(OP_FLOOR_DIVIDE, &a, &b, &div) &&
+            Number__binary(OP_REMAINDER, &a, &b, &mod))
+        {
+            PyObject *pdiv = Number__result(&div);
+            PyObject *pmod = pdiv ? Number__result(&mod) : NULL;
+            PyObject *ret = pmod ? PyTuple_Pack(2, pdiv, pmod) : NULL;
+            Py_XDECREF(pdiv);
+            Py_XDECREF(pmod);
+            return ret;
+        }
+        if (__emacs_results && Number__lisp_compatible(OP_FLOOR_DIVIDE, &a, &b)) {
+            PyObject *pdiv = EmacsObject__lisp_operation(OP_FLOOR_DIVIDE, self, other);
+            PyObject *pmod = pdiv ? EmacsObject__lisp_operation(OP_REMAINDER, self, other) : NULL;
+            PyObject *ret = pmod ? PyTuple_Pack(2, pdiv, pmod) : NULL;
+            Py_XDECREF(pdiv);
+            Py_XDECREF(pmod);
+            return ret;
+        }
+    }
 
+    PyObject *c_self = EmacsObject__normalize(self);
+    PyObject *c_other = c_self ? EmacsObject__normalize(other) : NULL;
+    PyObject *ret = c_other ? PyNumber_Divmod(c_self, c_other) : NULL;
+    Py_XDECREF(c_self);
+    Py_XDECREF(c_other);
     return ret;
 }
 
-#define NORMALIZED_BINARY_OPERATION(name, pyname)                               \
+#define BINARY_OPERATION(name, op, pyname)                                      \
     PyObject *EmacsObject_ ## name(PyObject *self, PyObject *other)             \
     {                                                                           \
-        PyObject *c_self = self, *c_other = other;                              \
-        if (PyObject_TypeCheck(self, &EmacsObjectType))                         \
-            c_self = EmacsObject__normalize(c_self);                            \
-        if (PyObject_TypeCheck(other, &EmacsObjectType))                        \
-            c_other = EmacsObject__normalize(c_other);                          \
-                                                                                \
-        PyObject *ret = NULL;                                                   \
-                                                                                \
-        if (c_self && c_other)                                                  \
-            ret = pyname(c_self, c_other);                                      \
-        else                                                                    \
-            PyErr_SetString(PyExc_TypeError, "Unsupported operand types");      \
-                                                                                \
-        Py_XDECREF(c_self);                                                     \
-        Py_XDECREF(c_other);                                                    \
-        return ret;                                                             \
-    }
-
-NORMALIZED_BINARY_OPERATION(add, PyNumber_Add)
-NORMALIZED_BINARY_OPERATION(subtract, PyNumber_Subtract)
-NORMALIZED_BINARY_OPERATION(multiply, PyNumber_Multiply)
-NORMALIZED_BINARY_OPERATION(remainder, PyNumber_Remainder)
-NORMALIZED_BINARY_OPERATION(divmod, PyNumber_Divmod)
-NORMALIZED_BINARY_OPERATION(lshift, PyNumber_Lshift)
-NORMALIZED_BINARY_OPERATION(rshift, PyNumber_Rshift)
-NORMALIZED_BINARY_OPERATION(floor_divide, PyNumber_FloorDivide)
-NORMALIZED_BINARY_OPERATION(true_divide, PyNumber_TrueDivide)
-
-#undef NORMALIZED_BINARY_OPERATION
-
-#define NORMALIZED_UNARY_OPERATION(name, pyname)                                \
+        return EmacsObject__binary(op, pyname, self, other);                    \
+    }
+
+BINARY_OPERATION(add, OP_ADD, PyNumber_Add)
+BINARY_OPERATION(subtract, OP_SUBTRACT, PyNumber_Subtract)
+BINARY_OPERATION(multiply, OP_MULTIPLY, PyNumber_Multiply)
+BINARY_OPERATION(remainder, OP_REMAINDER, PyNumber_Remainder)
+BINARY_OPERATION(lshift, OP_LSHIFT, PyNumber_Lshift)
+BINARY_OPERATION(rshift, OP_RSHIFT, PyNumber_Rshift)
+BINARY_OPERATION(floor_divide, OP_FLOOR_DIVIDE, PyNumber_FloorDivide)
+BINARY_OPERATION(true_divide, OP_TRUE_DIVIDE, PyNumber_TrueDivide)
+
+#undef BINARY_OPERATION
+
+#define UNARY_OPERATION(name, op, pyname)                                       \
     PyObject *EmacsObject_ ## name(PyObject *self)                              \
     {                                                                           \
-        PyObject *c_self = self;                                                \
-        if (PyObject_TypeCheck(self, &EmacsObjectType))                         \
-            c_self = EmacsObject__normalize(c_self);                            \
-                                                                                \
-        PyObject *ret = NULL;                                                   \
-                                                                                \
-        if (c_self)                                                             \
-            ret = pyname(c_self);                                               \
-        else                                                                    \
-            PyErr_SetString(PyExc_TypeError, "Unsupported operand types");      \
-                                                                                \
-        Py_XDECREF(c_self);                                                     \
-        return ret;                                                             \
+        return EmacsObject__unary(op, pyname, self);                            \
     }
 
-NORMALIZED_UNARY_OPERATION(negative, PyNumber_Negative)
-NORMALIZED_UNARY_OPERATION(positive, PyNumber_Positive)
-NORMALIZED_UNARY_OPERATION(absolute, PyNumber_Absolute)
-NORMALIZED_UNARY_OPERATION(invert, PyNumber_Invert)
+UNARY_OPERATION(negative, OP_NEGATIVE, PyNumber_Negative)
+UNARY_OPERATION(positive, OP_POSITIVE, PyNumber_Positive)
+UNARY_OPERATION(absolute, OP_ABSOLUTE, PyNumber_Absolute)
+UNARY_OPERATION(invert, OP_INVERT, PyNumber_Invert)
 
-#undef NORMALIZED_UNARY_OPERATION
+#undef UNARY_OPERATION
 
 
 
+// Comparison
+//
+// Numbers and strings compared with Python objects are compared natively, so
+// that no temporary Emacs objects are made. Other comparisons go through
+// em_compare().
+
+static PyObject *comparison_result(int cmp, int op)
+{
+    bool ret;
+    switch (op) {
+    case Py_LT: ret = cmp < 0; break;
+    case Py_LE: ret = cmp <= 0; break;
+    case Py_EQ: ret = cmp == 0; break;
+    case Py_NE: ret = cmp != 0; break;
+    case Py_GT: ret = cmp > 0; break;
+    default: ret = cmp >= 0;
+    }
+    return PyBool_FromLong(ret);
+}
+
+// Compare an integer with a float exactly, as Python does (f must not be NaN)
+static int compare_int_float(intmax_t i, double f)
+{
+    if (f >= -(double)INTMAX_MIN)
+        return -1;
+    if (f < (double)INTMAX_MIN)
+        return 1;
+    double whole = floor(f);
+    intmax_t fi = (intmax_t)whole;
+    if (i != fi)
+        return i < fi ? -1 : 1;
+    return whole < f ? -1 : 0;
+}
+
+static PyObject *Number__compare(Number *a, Number *b, int op)
+{
+    if ((a->kind == NUMBER_FLOAT && isnan(a->f)) || (b->kind == NUMBER_FLOAT && isnan(b->f)))
+        return PyBool_FromLong(op == Py_NE);
+
+    int cmp;
+    if (a->kind == NUMBER_INT && b->kind == NUMBER_INT)
+        cmp = (a->i > b->i) - (a->i < b->i);
+    else if (a->kind == NUMBER_FLOAT && b->kind == NUMBER_FLOAT)
+        cmp = (a->f > b->f) - (a->f < b->f);
+    else if (a->kind == NUMBER_INT)
+        cmp = compare_int_float(a->i, b->f);
+    else
+        cmp = -compare_int_float(b->i, a->f);
+    return comparison_result(cmp, op);
+}
+
+// Emacs strings are copied into a scratch buffer that is reused between calls
+static char *__scratch = NULL;
+static ptrdiff_t __scratch_size = 0;
+
+static PyObject *EmacsObject__compare_string(emacs_value a, PyObject *pb, int op)
+{
+    Py_ssize_t blen;
+    const char *b = PyUnicode_AsUTF8AndSize(pb, &blen);
+    if (!b)
+        return NULL;
+
+    ptrdiff_t alen = em_strn_size(a);
+    if (propagate_emacs_error())
+        return NULL;
+    if ((op == Py_EQ || op == Py_NE) && alen != blen)
+        return PyBool_FromLong(op == Py_NE);
+
+    if (alen + 1 > __scratch_size) {
+        ptrdiff_t size = 2 * __scratch_size > alen + 1 ? 2 * __scratch_size : alen + 1;
+        char *scratch = (char *)realloc(__scratch, size);
+        if (!scratch)
+            return PyErr_NoMemory();
+        __scratch = scratch;
+        __scratch_size = size;
+    }
+    if (!em_copy_strn(a, __scratch, __scratch_size)) {
+        if (!propagate_emacs_error())
+            PyErr_SetString(PyExc_RuntimeError, "Unable to copy string contents");
+        return NULL;
+    }
+
+    // UTF-8 preserves the order of character codes, as used by string<
+    int cmp = memcmp(__scratch, b, alen < blen ? alen : blen);
+    if (cmp == 0)
+        cmp = (alen > blen) - (alen < blen);
+    return comparison_result(cmp, op);
+}
+
+PyObject *EmacsObject_cmp(PyObject *pa, PyObject *pb, int op)
+{
+    emacs_value a = ((EmacsObject *)pa)->val;
+    emacs_value b = NULL;
+
+    Number na, nb;
+    NumberKind ka = EmacsObject__number(pa, &na);
+    if (ka == NUMBER_INT || ka == NUMBER_FLOAT) {
+        NumberKind kb = EmacsObject__number(pb, &nb);
+        if (kb == NUMBER_INT || kb == NUMBER_FLOAT)
+            return Number__compare(&na, &nb, op);
+    }
+    else if (ka == NUMBER_NONE && PyUnicode_Check(pb) && em_stringp(a))
+        return EmacsObject__compare_string(a, pb, op);
+
+    // Slow path for bignums, and objects that aren't numbers or strings
+    if (em_numberp(a) && PyLong_Check(pb)) {
+        if (!EmacsObject__int(pb, &b)) {
+            // Without bignums in Emacs, compare as Python numbers instead
+            if (!PyErr_ExceptionMatches(PyExc_OverflowError))
+                return NULL;
+            PyErr_Clear();
+            PyObject *pa_num = em_integerp(a) ? EmacsObject__pylong(a) : PyNumber_Float(pa);
+            if (!pa_num)
+                return NULL;
+            PyObject *ret = PyObject_RichCompare(pa_num, pb, op);
+            Py_DECREF(pa_num);
+            return ret;
+        }
+    }
+    else if (em_numberp(a) && PyFloat_Check(pb)) {
+        double val = PyFloat_AsDouble(pb);
+        if (PyErr_Occurred())
+            return NULL;
+        b = em_float(val);
+    }
+    else if (em_stringp(a) && PyUnicode_Check(pb)) {
+        if (!EmacsObject__string(pb, &b))
+            return NULL;
+    }
+    else if (!PyObject_TypeCheck(pb, &EmacsObjectType)) {
+        if (op == Py_EQ)
+            Py_RETURN_FALSE;
+        else if (op == Py_NE)
+            Py_RETURN_TRUE;
+        else {
+            PyErr_SetString(PyExc_TypeError, "Unorderable types");
+            return NULL;
+        }
+    }
+    else
+        b = ((EmacsObject *)pb)->val;
+
+    bool error;
+    bool ret = em_compare(a, b, op, &error);
+
+    if (error) {
+        PyErr_SetString(PyExc_TypeError, "Unorderable types");
+        return NULL;
+    }
+    else if (ret)
+        Py_RETURN_TRUE;
+    Py_RETURN_FALSE;
+}
+
+
+
 // Emacs type checking
 
 DOCSTRING(EmacsObject_type,
@@ -498,10 +1643,7 @@ DOCSTRING(EmacsObject_type,
 PyObject *EmacsObject_type(PyObject *self)
 {
     emacs_value obj = ((EmacsObject *)self)->val;
-    char *str = em_type_of(obj);
-    PyObject *ret = PyUnicode_FromString(str);
-    free(str);
-    return ret;
+    return EmacsObject__symbol_str(em_type(obj));
 }
 
 DOCSTRING(EmacsObject_is_a,
@@ -514,7 +1656,12 @@ PyObject *EmacsObject_is_a(PyObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "s", &type))
         return NULL;
     emacs_value obj = ((EmacsObject *)self)->val;
-    if (em_type_is(obj, type))
+
+    // Don't intern misspelled type names
+    emacs_value sym = em_funcall_1(em__intern_soft, em_str(type));
+    if (propagate_emacs_error())
+        return NULL;
+    if (em_truthy(sym) && em_type_is(obj, sym))
         Py_RETURN_TRUE;
     Py_RETURN_FALSE;
 }
@@ -596,7 +1743,7 @@ static PySequenceMethods EmacsObject_SequenceMethods[] = {{
     0,                                // sq_repeat
     EmacsObject_GetItem,              // sq_item
     0,                                // was_sq_slice
-    0,                                // sq_ass_item
+    EmacsObject_SetItem,              // sq_ass_item
     0,                                // was_sq_ass_slice
     0,                                // sq_contains
     0,                                // sq_inplace_concat
@@ -617,7 +1764,7 @@ PyTypeObject EmacsObjectType = {
     EmacsObject_NumMethods,           // tp_as_number
     EmacsObject_SequenceMethods,      // tp_as_sequence
     0,                                // tp_as_mapping
-    0,                                // tp_hash
+    EmacsObject_hash,                 // tp_hash
     EmacsObject_call,                 // tp_call
     EmacsObject_str,                  // tp_str
     0,                                // tp_getattro
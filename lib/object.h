@@ -13,15 +13,156 @@
 typedef struct {
     PyObject_HEAD
     emacs_value val;
+    bool global;
+    PyObject *site;
+    Py_hash_t hash;
 } EmacsObject;
 
+/**
+ * \brief Wrap an Emacs value in a new Python object.
+ *
+ * The value is pinned with a global reference, so the object may outlive the
+ * current Emacs environment.
+ */
 PyObject *EmacsObject__make(PyTypeObject *type, emacs_value val);
 
+/**
+ * \brief Wrap an Emacs value without creating a global reference.
+ *
+ * The object is only valid for as long as the current Emacs environment. Call
+ * EmacsObject__promote() before the environment is popped if it must survive.
+ */
+PyObject *EmacsObject__make_local(PyTypeObject *type, emacs_value val);
+
+/**
+ * \brief Pin the value of a local object with a global reference.
+ */
+void EmacsObject__promote(EmacsObject *self);
+
+/**
+ * \brief Get the shared wrapper for nil.
+ * \return A new reference.
+ */
+PyObject *EmacsObject__nil();
+
+/**
+ * \brief Get the shared wrapper for t.
+ * \return A new reference.
+ */
+PyObject *EmacsObject__t();
+
+/**
+ * \brief Get the shared wrapper for a small integer.
+ * \return A new reference, or NULL without an error set if the integer is
+ * outside the shared range.
+ */
+PyObject *EmacsObject__small_int(intmax_t i);
+
+/**
+ * \brief Get, and optionally set, the range of integers with shared wrappers.
+ * \param low The lowest shared integer, set to the previous value.
+ * \param high The highest shared integer, set to the previous value. If high
+ * is less than low, no integers are shared.
+ * \param set Whether to set the range.
+ */
+void EmacsObject__small_int_range(intmax_t *low, intmax_t *high, bool set);
+
+/**
+ * \brief Hand a Python object to Emacs as an opaque user pointer.
+ *
+ * The user pointer owns a reference to the object, which is released by its
+ * finalizer when Emacs collects it.
+ *
+ * \return The user pointer, or NULL if an Emacs error is pending.
+ */
+emacs_value EmacsObject__handle(PyObject *obj);
+
+/**
+ * \brief Get the Python object owned by a user pointer made by
+ * EmacsObject__handle().
+ * \return A new reference, or NULL without an error set if the value is not
+ * such a user pointer.
+ */
+PyObject *EmacsObject__unwrap(emacs_value val);
+
+/**
+ * \brief Enable or disable recording of the Python source location that
+ * creates each global reference.
+ */
+void EmacsObject__track_sites(bool enable);
+
+/**
+ * \brief Get statistics for global references held by Python objects.
+ * \param live Set to the number of live references.
+ * \return A new dict mapping (filename, lineno) to live reference counts, or
+ * None if sites are not being tracked.
+ */
+PyObject *EmacsObject__ref_stats(size_t *live);
+
+/**
+ * \brief Convert a Python int to an Emacs integer, using bignums if needed.
+ * \return True on success, false with a Python error set otherwise.
+ */
+bool EmacsObject__int(PyObject *arg, emacs_value *ret);
+
+/**
+ * \brief Convert an Emacs integer to a Python int of any size.
+ */
+PyObject *EmacsObject__pylong(emacs_value val);
+
+/**
+ * \brief Convert a Python str to an Emacs string, without truncating at NULs.
+ * \return True on success, false with a Python error set otherwise.
+ */
+bool EmacsObject__string(PyObject *arg, emacs_value *ret);
+
+/**
+ * \brief Convert an Emacs string to a Python str, without truncating at NULs.
+ */
+PyObject *EmacsObject__pystring(emacs_value val);
+
+/**
+ * \brief Choose whether arithmetic on Emacs objects returns Emacs numbers
+ * (true) or Python numbers (false, the default).
+ */
+void EmacsObject__emacs_results(bool enable);
+bool EmacsObject__emacs_results_p();
+
+/**
+ * \brief Flags controlling the shape of converted Python data.
+ */
+enum {
+    CONVERT_SYMBOL = 1 << 0,        // Strings become symbols
+    CONVERT_VECTOR = 1 << 1,        // Lists and tuples become vectors
+    CONVERT_ALIST = 1 << 2,         // Dicts become alists
+    CONVERT_HASH_TABLE = 1 << 3,    // Dicts become hash tables (takes precedence)
+    CONVERT_SYMBOL_KEYS = 1 << 4,   // Dict keys that are strings become symbols
+};
+
+/**
+ * \brief Convert a Python object to an Emacs object.
+ *
+ * Builtin containers are converted recursively in a single pass, without
+ * probing for __emacs__ methods. Dicts are only converted if one of the dict
+ * flags is given.
+ *
+ * \param flags A combination of CONVERT_ flags.
+ * \return True on success. On failure, a Python error may or may not be set.
+ */
+bool EmacsObject__convert(PyObject *arg, int flags, emacs_value *ret);
+
 /**
  * \brief Coerce a Python object to an Emacs object.
  */
 bool EmacsObject__coerce(PyObject *arg, bool prefer_symbol, emacs_value *ret);
 
+/**
+ * \brief Parse a shape specification into CONVERT_ flags.
+ * \param spec None, a shape name, or a sequence of shape names.
+ * \return True on success, false with a Python error set otherwise.
+ */
+bool EmacsObject__parse_shape(PyObject *spec, int *flags);
+
 PyTypeObject EmacsObjectType;
 
 #endif /* OBJECT_H */
@@ -0,0 +1,355 @@
+#include <Python.h>
+#include <stdbool.h>
+
+#include "emacs-interface.h"
+#include "error.h"
+#include "object.h"
+
+#include "sort.h"
+
+
+
+// Sort keys
+//
+// Keys are extracted once per element. Without a predicate they are stored as
+// native numbers or UTF-8 strings, so that sorting doesn't call Emacs at all.
+// UTF-8 preserves the order of character codes, so strings compare with
+// memcmp like string< would.
+
+typedef enum {
+    KEY_INT,
+    KEY_FLOAT,
+    KEY_STRING,
+    KEY_OBJECT,
+} KeyKind;
+
+typedef struct {
+    KeyKind kind;
+    intmax_t i;
+    double f;
+    const char *str;
+    ptrdiff_t len;
+    bool owned;             // Whether str must be freed
+    emacs_value key;        // The key as an Emacs object, if needed
+    PyObject *pykey;        // The key as a Python object, if needed
+    emacs_value elem;
+    emacs_value cell;       // The cons cell holding elem, for lists
+} SortItem;
+
+typedef struct {
+    PyObject *predicate;
+    bool reverse;
+} SortOrder;
+
+// Wrap a value for a Python callback, pinning it only if the callback keeps it
+static PyObject *SortItem__wrap(emacs_value val)
+{
+    return EmacsObject__make_local(&EmacsObjectType, val);
+}
+
+static void SortItem__release(PyObject *obj)
+{
+    if (PyObject_TypeCheck(obj, &EmacsObjectType) && Py_REFCNT(obj) > 1)
+        EmacsObject__promote((EmacsObject *)obj);
+    Py_DECREF(obj);
+}
+
+static bool SortItem__native(SortItem *self, emacs_value key)
+{
+    emacs_value type = em_type(key);
+
+    if (em_eq(type, em__integer)) {
+        if (em_extract_int_exact(key, &self->i))
+            self->kind = KEY_INT;
+        else {
+            // Bignums are compared approximately
+            self->kind = KEY_FLOAT;
+            self->f = em_extract_float(em_funcall_1(em__float, key));
+        }
+    }
+    else if (em_eq(type, em__float)) {
+        self->kind = KEY_FLOAT;
+        self->f = em_extract_float(key);
+    }
+    else if (em_eq(type, em__string)) {
+        self->kind = KEY_STRING;
+        self->str = em_extract_strn(key, &self->len);
+        self->owned = true;
+    }
+    else {
+        PyErr_SetString(PyExc_TypeError, "Sort keys must be numbers or strings, or use a predicate");
+        return false;
+    }
+
+    return !propagate_emacs_error();
+}
+
+static bool SortItem__native_py(SortItem *self, PyObject *key)
+{
+    if (PyObject_TypeCheck(key, &EmacsObjectType))
+        return SortItem__native(self, ((EmacsObject *)key)->val);
+
+    if (PyLong_Check(key)) {
+        int overflow;
+        long long i = PyLong_AsLongLongAndOverflow(key, &overflow);
+        if (overflow) {
+            self->kind = KEY_FLOAT;
+            self->f = PyLong_AsDouble(key);
+        }
+        else {
+            self->kind = KEY_INT;
+            self->i = i;
+        }
+        return !PyErr_Occurred();
+    }
+
+    if (PyFloat_Check(key)) {
+        self->kind = KEY_FLOAT;
+        self->f = PyFloat_AS_DOUBLE(key);
+        return true;
+    }
+
+    if (PyUnicode_Check(key)) {
+        Py_ssize_t len;
+        self->kind = KEY_STRING;
+        self->str = PyUnicode_AsUTF8AndSize(key, &len);
+        self->len = len;
+        return self->str != NULL;
+    }
+
+    PyErr_SetString(PyExc_TypeError, "Sort keys must be numbers or strings, or use a predicate");
+    return false;
+}
+
+static bool SortItem__init(SortItem *self, PyObject *key, SortOrder *order)
+{
+    self->key = self->elem;
+
+    if (PyObject_TypeCheck(key, &EmacsObjectType)) {
+        self->key = em_funcall_1(((EmacsObject *)key)->val, self->elem);
+        if (propagate_emacs_error())
+            return false;
+    }
+    else if (key != Py_None) {
+        PyObject *arg = SortItem__wrap(self->elem);
+        if (!arg)
+            return false;
+        self->pykey = PyObject_CallFunctionObjArgs(key, arg, NULL);
+        SortItem__release(arg);
+        if (!self->pykey)
+            return false;
+
+        if (!order->predicate)
+            return SortItem__native_py(self, self->pykey);
+
+        // An Emacs predicate needs Emacs keys. The Python key owns the
+        // value, so it stays valid while the key is alive.
+        self->kind = KEY_OBJECT;
+        if (PyObject_TypeCheck(order->predicate, &EmacsObjectType)
+            && !EmacsObject__coerce(self->pykey, false, &self->key)) {
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_TypeError, "Unable to coerce sort key to Emacs object");
+            return false;
+        }
+        return true;
+    }
+
+    if (!order->predicate)
+        return SortItem__native(self, self->key);
+    self->kind = KEY_OBJECT;
+    return true;
+}
+
+static void SortItem__free(SortItem *self)
+{
+    if (self->owned)
+        free((char *)self->str);
+    if (self->pykey)
+        SortItem__release(self->pykey);
+}
+
+static int SortItem__predicate(SortItem *a, SortItem *b, PyObject *predicate)
+{
+    if (PyObject_TypeCheck(predicate, &EmacsObjectType)) {
+        emacs_value ret = em_funcall_2(((EmacsObject *)predicate)->val, a->key, b->key);
+        if (propagate_emacs_error())
+            return -1;
+        return em_truthy(ret);
+    }
+
+    // Each key is wrapped at most once
+    if (!a->pykey && !(a->pykey = SortItem__wrap(a->key)))
+        return -1;
+    if (!b->pykey && !(b->pykey = SortItem__wrap(b->key)))
+        return -1;
+
+    PyObject *ret = PyObject_CallFunctionObjArgs(predicate, a->pykey, b->pykey, NULL);
+    if (!ret)
+        return -1;
+    int truth = PyObject_IsTrue(ret);
+    Py_DECREF(ret);
+    return truth;
+}
+
+// Returns 1 if a sorts strictly before b, 0 if not, and -1 on error
+static int SortItem__less(SortItem *a, SortItem *b, SortOrder *order)
+{
+    if (order->reverse) {
+        SortItem *tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    if (order->predicate)
+        return SortItem__predicate(a, b, order->predicate);
+
+    if (a->kind == KEY_STRING) {
+        int cmp = memcmp(a->str, b->str, a->len < b->len ? a->len : b->len);
+        return cmp < 0 || (cmp == 0 && a->len < b->len);
+    }
+
+    if (a->kind == KEY_INT && b->kind == KEY_INT)
+        return a->i < b->i;
+
+    double x = a->kind == KEY_INT ? (double)a->i : a->f;
+    double y = b->kind == KEY_INT ? (double)b->i : b->f;
+    return x < y;
+}
+
+
+
+// Merge sort
+//
+// A bottom-up merge sort over pointers, alternating between two arrays. Runs
+// that are already in order are copied without merging, so sorted input only
+// takes one comparison per run.
+
+static SortItem **merge_sort(SortItem **items, SortItem **tmp, ptrdiff_t n, SortOrder *order)
+{
+    for (ptrdiff_t width = 1; width < n; width *= 2) {
+        for (ptrdiff_t lo = 0; lo < n; lo += 2 * width) {
+            ptrdiff_t mid = lo + width < n ? lo + width : n;
+            ptrdiff_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+
+            if (mid < hi) {
+                int less = SortItem__less(items[mid], items[mid - 1], order);
+                if (less < 0)
+                    return NULL;
+                if (less) {
+                    ptrdiff_t i = lo, j = mid, k = lo;
+                    while (i < mid && j < hi) {
+                        less = SortItem__less(items[j], items[i], order);
+                        if (less < 0)
+                            return NULL;
+                        tmp[k++] = less ? items[j++] : items[i++];
+                    }
+                    while (i < mid)
+                        tmp[k++] = items[i++];
+                    while (j < hi)
+                        tmp[k++] = items[j++];
+                    continue;
+                }
+            }
+            memcpy(&tmp[lo], &items[lo], (hi - lo) * sizeof(SortItem *));
+        }
+
+        SortItem **swap = items;
+        items = tmp;
+        tmp = swap;
+    }
+    return items;
+}
+
+
+
+// Sorting
+
+PUBLIC_DOCSTRING(py_sort,
+                 "sort(seq, key=None, reverse=False, predicate=None)\n\n"
+                 "Sorts an Emacs list or vector in place with a stable merge sort, and returns "
+                 "the sorted sequence. Like :lisp:`sort`, lists are sorted by relinking their "
+                 "cons cells, so use the return value, not the original list.\n\n"
+                 "The `key` function is called once per element. It is either a Python "
+                 "callable, which receives an :class:`.EmacsObject`, or an Emacs function. "
+                 "Without a `predicate`, the keys must be all numbers or all strings. They "
+                 "are extracted once, and then compared natively without calling Emacs. "
+                 "Strings are compared by character codes, like :lisp:`string<`.\n\n"
+                 "Otherwise `predicate` is a Python or Emacs function of two keys that "
+                 "returns true if the first sorts before the second.")
+PyObject *py_sort(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    UNUSED(self);
+    PyObject *seq, *key = Py_None, *predicate = Py_None;
+    int reverse = false;
+    char *keywords[] = {"seq", "key", "reverse", "predicate", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|OpO", keywords,
+                                     &EmacsObjectType, &seq, &key, &reverse, &predicate))
+        return NULL;
+
+    emacs_value val = ((EmacsObject *)seq)->val;
+    bool vector = em_vectorp(val);
+    if (!vector && !em_listp(val)) {
+        PyErr_SetString(PyExc_TypeError, "Expected an Emacs list or vector");
+        return NULL;
+    }
+
+    Py_ssize_t n = PySequence_Size(seq);
+    if (n < 0)
+        return NULL;
+    if (n == 0) {
+        Py_INCREF(seq);
+        return seq;
+    }
+
+    SortOrder order = {predicate == Py_None ? NULL : predicate, reverse};
+    SortItem *items = (SortItem *)calloc(n, sizeof(SortItem));
+    SortItem **sorted = (SortItem **)malloc(2 * n * sizeof(SortItem *));
+
+    bool success = true;
+    emacs_value cell = val;
+    for (Py_ssize_t i = 0; i < n && success; i++) {
+        if (vector)
+            items[i].elem = em_vec_get(val, i);
+        else {
+            items[i].cell = cell;
+            items[i].elem = em_funcall_1(em__car, cell);
+            cell = em_funcall_1(em__cdr, cell);
+        }
+        sorted[i] = &items[i];
+        success = SortItem__init(&items[i], key, &order);
+    }
+
+    if (success && !order.predicate) {
+        bool strings = items[0].kind == KEY_STRING;
+        for (Py_ssize_t i = 1; i < n && success; i++)
+            success = (items[i].kind == KEY_STRING) == strings;
+        if (!success)
+            PyErr_SetString(PyExc_TypeError, "Sort keys must be all numbers or all strings");
+    }
+
+    SortItem **result = success ? merge_sort(sorted, &sorted[n], n, &order) : NULL;
+
+    PyObject *ret = NULL;
+    if (result && vector) {
+        for (Py_ssize_t i = 0; i < n; i++)
+            em_vec_set(val, i, result[i]->elem);
+        Py_INCREF(seq);
+        ret = seq;
+    }
+    else if (result) {
+        for (Py_ssize_t i = 0; i < n; i++)
+            em_setcdr(result[i]->cell, i + 1 < n ? result[i + 1]->cell : em__nil);
+        ret = EmacsObject__make(&EmacsObjectType, result[0]->cell);
+    }
+
+    for (Py_ssize_t i = 0; i < n; i++)
+        SortItem__free(&items[i]);
+    free(items);
+    free(sorted);
+
+    if (ret && propagate_emacs_error()) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    return ret;
+}
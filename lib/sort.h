@@ -0,0 +1,13 @@
+#include <Python.h>
+
+#include "util.h"
+
+#ifndef SORT_H
+#define SORT_H
+
+
+EXTERN_DOCSTRING(py_sort)
+PyObject *py_sort(PyObject *self, PyObject *args, PyObject *kwds);
+
+
+#endif /* SORT_H */
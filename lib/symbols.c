@@ -0,0 +1,465 @@
+#include <Python.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "emacs-interface.h"
+#include "error.h"
+#include "object.h"
+
+#include "symbols.h"
+
+
+
+// Symbol index
+//
+// A prefix trie of the names of all interned symbols, used to rule out
+// candidate names without asking Emacs. Only the nodes where a separator may
+// start are kept, i.e. the prefixes ending in ASCII punctuation, plus a marker
+// for each complete name. Nodes are stored as 64-bit hashes of their paths in
+// an open addressing set, which keeps the index to a few megabytes and makes
+// lookups free of allocations. A collision only costs an extra intern-soft,
+// since Emacs confirms every hit.
+//
+// Emacs doesn't report new symbols, but it counts them in symbols-consed, so
+// the index is only used for pruning while that count is unchanged since the
+// last synchronization. Reading it is one funcall per lookup or search, which
+// can't be cached, since any Lisp code run in between may intern symbols. Symbols interned with symbols_intern are added as they
+// are created. Uninterned symbols (make-symbol, gensym) are counted too, so a
+// stale index is not rebuilt right away. Lookups then ask Emacs about every
+// candidate, and the index is synchronized again once those lookups have cost
+// about as much as rebuilding it would.
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+// Never part of UTF-8, so it can mark the end of a name
+#define END_OF_NAME 0xff
+
+typedef struct {
+    uint64_t *slots;        // Zero means empty
+    size_t capacity;        // A power of two
+    size_t count;
+    bool built;
+    bool broken;            // The index couldn't be built, so don't prune
+    intmax_t consed;        // symbols-consed when last synchronized
+    size_t names;           // Number of names when last synchronized
+    size_t stale_lookups;   // Unpruned lookups since the index went stale
+} SymbolIndex;
+
+static SymbolIndex __index = {NULL, 0, 0, false, false, 0, 0, 0};
+static emacs_value __symbol_names = NULL;
+
+static const char *symbol_names_source =
+    "(lambda ()"
+    "  (let (names)"
+    "    (mapatoms (lambda (s) (push (symbol-name s) names)))"
+    "    (mapconcat #'identity names \"\\0\")))";
+
+static inline uint64_t hash_step(uint64_t h, unsigned char c)
+{
+    return (h ^ c) * FNV_PRIME;
+}
+
+static inline bool boundary(unsigned char c)
+{
+    return c < 0x80 && !isalnum(c);
+}
+
+static inline size_t SymbolIndex__slot(SymbolIndex *self, uint64_t h)
+{
+    return (size_t)(h ^ (h >> 32)) & (self->capacity - 1);
+}
+
+static void SymbolIndex__insert(SymbolIndex *self, uint64_t h);
+
+static void SymbolIndex__grow(SymbolIndex *self)
+{
+    uint64_t *slots = self->slots;
+    size_t capacity = self->capacity;
+
+    self->capacity = capacity ? 2 * capacity : 1 << 16;
+    self->slots = (uint64_t *)calloc(self->capacity, sizeof(uint64_t));
+    self->count = 0;
+    for (size_t i = 0; i < capacity; i++)
+        if (slots[i])
+            SymbolIndex__insert(self, slots[i]);
+    free(slots);
+}
+
+static void SymbolIndex__insert(SymbolIndex *self, uint64_t h)
+{
+    if (!h)
+        h = 1;
+    if (2 * (self->count + 1) > self->capacity)
+        SymbolIndex__grow(self);
+
+    for (size_t i = SymbolIndex__slot(self, h);; i = (i + 1) & (self->capacity - 1)) {
+        if (self->slots[i] == h)
+            return;
+        if (!self->slots[i]) {
+            self->slots[i] = h;
+            self->count++;
+            return;
+        }
+    }
+}
+
+static bool SymbolIndex__contains(SymbolIndex *self, uint64_t h)
+{
+    if (!h)
+        h = 1;
+    for (size_t i = SymbolIndex__slot(self, h);; i = (i + 1) & (self->capacity - 1)) {
+        if (self->slots[i] == h)
+            return true;
+        if (!self->slots[i])
+            return false;
+    }
+}
+
+static void SymbolIndex__add(SymbolIndex *self, const char *name, ptrdiff_t len)
+{
+    uint64_t h = FNV_OFFSET;
+    for (ptrdiff_t i = 0; i < len; i++) {
+        h = hash_step(h, (unsigned char)name[i]);
+        if (boundary(name[i]))
+            SymbolIndex__insert(self, h);
+    }
+    SymbolIndex__insert(self, hash_step(h, END_OF_NAME));
+}
+
+static bool SymbolIndex__has_name(SymbolIndex *self, const char *name, ptrdiff_t len)
+{
+    uint64_t h = FNV_OFFSET;
+    for (ptrdiff_t i = 0; i < len; i++) {
+        h = hash_step(h, (unsigned char)name[i]);
+        if (boundary(name[i]) && !SymbolIndex__contains(self, h))
+            return false;
+    }
+    return SymbolIndex__contains(self, hash_step(h, END_OF_NAME));
+}
+
+static intmax_t symbols_consed()
+{
+    return em_extract_int(em_funcall_1(em__symbol_value, em__symbols_consed));
+}
+
+// Add the names of all interned symbols. Names are only ever added, so
+// symbols that have been uninterned may still match, which is harmless.
+static bool SymbolIndex__sync(SymbolIndex *self)
+{
+    if (!__symbol_names) {
+        emacs_value func = em_byte_compile(em_read(symbol_names_source));
+        if (propagate_emacs_error())
+            return false;
+        __symbol_names = em_make_global(func);
+    }
+
+    intmax_t consed = symbols_consed();
+    emacs_value names = em_funcall_0(__symbol_names);
+    if (propagate_emacs_error())
+        return false;
+
+    ptrdiff_t len;
+    char *buffer = em_extract_strn(names, &len);
+    if (propagate_emacs_error()) {
+        free(buffer);
+        return false;
+    }
+
+    // Names are separated by NUL
+    ptrdiff_t start = 0;
+    size_t nnames = 0;
+    for (ptrdiff_t i = 0; i <= len; i++)
+        if (i == len || !buffer[i]) {
+            SymbolIndex__add(self, &buffer[start], i - start);
+            start = i + 1;
+            nnames++;
+        }
+    free(buffer);
+
+    self->consed = consed;
+    self->names = nnames;
+    self->stale_lookups = 0;
+    self->built = true;
+    return true;
+}
+
+// Whether the index can be used for pruning, building it if necessary. A
+// stale index is synchronized again once enough lookups have gone unpruned.
+static bool SymbolIndex__ready(SymbolIndex *self)
+{
+    if (self->broken)
+        return false;
+    if (self->built) {
+        intmax_t consed = symbols_consed();
+        if (propagate_emacs_error())
+            return false;
+        if (consed == self->consed)
+            return true;
+        if (self->stale_lookups < self->names)
+            return false;
+    }
+    if (!SymbolIndex__sync(self)) {
+        // Without an index, fall back to asking Emacs about every name
+        self->broken = !self->built;
+        self->stale_lookups = 0;
+        PyErr_Clear();
+        return false;
+    }
+    return true;
+}
+
+// Record a lookup that couldn't be pruned, and the name if it was found
+static void SymbolIndex__note(SymbolIndex *self, const char *name, ptrdiff_t len, bool found)
+{
+    if (!self->built)
+        return;
+    self->stale_lookups++;
+    if (found)
+        SymbolIndex__add(self, name, len);
+}
+
+emacs_value symbols_intern(const char *name)
+{
+    if (!__index.built)
+        return em_intern(name);
+
+    // A name missing from the index wasn't interned when the index was last
+    // synchronized. If this intern is then the only new symbol, the index
+    // stays complete once the name is added.
+    ptrdiff_t len = strlen(name);
+    bool known = SymbolIndex__has_name(&__index, name, len);
+    emacs_value sym = em_intern(name);
+    intmax_t consed = symbols_consed();
+    SymbolIndex__add(&__index, name, len);
+
+    if (consed == __index.consed + (known ? 0 : 1))
+        __index.consed = consed;
+    return sym;
+}
+
+// Look up a symbol without creating it. Returns true if it exists.
+static bool lookup(const char *name, ptrdiff_t len, emacs_value *sym)
+{
+    emacs_value ret = em_funcall_1(em__intern_soft, em_strn(name, len));
+    if (em_truthy(ret)) {
+        *sym = ret;
+        return true;
+    }
+
+    // intern-soft returns nil both for nil and for missing symbols
+    if (len == 3 && !memcmp(name, "nil", 3)) {
+        *sym = em__nil;
+        return true;
+    }
+    return false;
+}
+
+PUBLIC_DOCSTRING(py_intern_soft,
+                 "intern_soft(name)\n\n"
+                 "Returns the interned symbol with the given name, or None if there is no such "
+                 "symbol. Unlike :func:`intern`, this never creates a symbol. Equivalent to "
+                 ":lisp:`(intern-soft name)` in elisp, except that :code:`nil` is found too.")
+PyObject *py_intern_soft(PyObject *self, PyObject *args)
+{
+    UNUSED(self);
+    char *name;
+    if (!PyArg_ParseTuple(args, "s", &name))
+        return NULL;
+    ptrdiff_t len = strlen(name);
+
+    bool prune = SymbolIndex__ready(&__index);
+    if (PyErr_Occurred())
+        return NULL;
+    if (prune && !SymbolIndex__has_name(&__index, name, len))
+        Py_RETURN_NONE;
+
+    emacs_value sym;
+    bool found = lookup(name, len, &sym);
+    if (propagate_emacs_error())
+        return NULL;
+    if (!prune)
+        SymbolIndex__note(&__index, name, len, found);
+    if (!found)
+        Py_RETURN_NONE;
+    return EmacsObject__make(&EmacsObjectType, sym);
+}
+
+
+
+// Candidate search
+//
+// A depth-first search over the product of the parts, extending the hash of
+// the name one byte at a time and pruning at every separator that isn't a
+// node in the index.
+
+typedef struct {
+    const char *str;
+    Py_ssize_t len;
+} Part;
+
+typedef struct {
+    Py_ssize_t rank;
+    emacs_value sym;
+} Hit;
+
+typedef struct {
+    Part **parts;
+    Py_ssize_t *nalts;
+    Py_ssize_t nparts;
+    char *buffer;
+    bool prune;
+    Hit *hits;
+    Py_ssize_t nhits, capacity;
+} Search;
+
+static bool Search__leaf(Search *self, ptrdiff_t len, uint64_t h, Py_ssize_t rank)
+{
+    if (self->prune && !SymbolIndex__contains(&__index, hash_step(h, END_OF_NAME)))
+        return true;
+
+    emacs_value sym;
+    bool found = lookup(self->buffer, len, &sym);
+    if (propagate_emacs_error())
+        return false;
+    if (!self->prune)
+        SymbolIndex__note(&__index, self->buffer, len, found);
+    if (!found)
+        return true;
+
+    if (self->nhits == self->capacity) {
+        self->capacity = self->capacity ? 2 * self->capacity : 4;
+        self->hits = (Hit *)realloc(self->hits, self->capacity * sizeof(Hit));
+    }
+    self->hits[self->nhits].rank = rank;
+    self->hits[self->nhits].sym = sym;
+    self->nhits++;
+    return true;
+}
+
+// The first part varies fastest in the priority order, so the rank of a
+// candidate is a mixed radix number with the first part as the lowest digit
+static bool Search__run(Search *self, Py_ssize_t level, ptrdiff_t len, uint64_t h,
+                        Py_ssize_t rank, Py_ssize_t stride)
+{
+    if (level == self->nparts)
+        return Search__leaf(self, len, h, rank);
+
+    for (Py_ssize_t j = 0; j < self->nalts[level]; j++) {
+        Part *part = &self->parts[level][j];
+        uint64_t hj = h;
+        bool pruned = false;
+        for (Py_ssize_t i = 0; i < part->len && !pruned; i++) {
+            unsigned char c = part->str[i];
+            self->buffer[len + i] = c;
+            hj = hash_step(hj, c);
+            pruned = self->prune && boundary(c) && !SymbolIndex__contains(&__index, hj);
+        }
+        if (pruned)
+            continue;
+        if (!Search__run(self, level + 1, len + part->len, hj,
+                         rank + j * stride, stride * self->nalts[level]))
+            return false;
+    }
+    return true;
+}
+
+PUBLIC_DOCSTRING(py_find_symbols,
+                 "find_symbols(parts)\n\n"
+                 "Finds the interned symbols whose names are made by concatenating one string "
+                 "from each element of `parts`, a sequence of sequences of strings. Returns a "
+                 "list of symbols ordered by the indices of the chosen strings, where the first "
+                 "part varies fastest.\n\n"
+                 "No symbols are created. Candidates are pruned against an index of the "
+                 "names of all interned symbols, which is built with :lisp:`mapatoms` on "
+                 "first use. Each call reads :lisp:`symbols-consed` once to check that the "
+                 "index is up to date, and then names that don't exist usually cost no "
+                 "further calls to Emacs. While other code is making symbols, the index may "
+                 "be out of date, and every candidate is checked with :lisp:`intern-soft` "
+                 "instead until the index is rebuilt.")
+PyObject *py_find_symbols(PyObject *self, PyObject *args)
+{
+    UNUSED(self);
+    PyObject *arg;
+    if (!PyArg_ParseTuple(args, "O", &arg))
+        return NULL;
+
+    PyObject *seq = PySequence_Fast(arg, "Expected a sequence of sequences of strings");
+    if (!seq)
+        return NULL;
+
+    Search search = {NULL, NULL, PySequence_Fast_GET_SIZE(seq), NULL, false, NULL, 0, 0};
+    Py_ssize_t n = search.nparts;
+    PyObject **alts = (PyObject **)calloc(n > 0 ? n : 1, sizeof(PyObject *));
+    search.parts = (Part **)calloc(n > 0 ? n : 1, sizeof(Part *));
+    search.nalts = (Py_ssize_t *)calloc(n > 0 ? n : 1, sizeof(Py_ssize_t));
+
+    // The strings are owned by the sequences, which are kept until the end
+    bool success = true;
+    Py_ssize_t size = 1;
+    for (Py_ssize_t k = 0; k < n && success; k++) {
+        alts[k] = PySequence_Fast(PySequence_Fast_GET_ITEM(seq, k),
+                                  "Expected a sequence of sequences of strings");
+        if (!(success = alts[k] != NULL))
+            break;
+        search.nalts[k] = PySequence_Fast_GET_SIZE(alts[k]);
+        search.parts[k] = (Part *)malloc((search.nalts[k] > 0 ? search.nalts[k] : 1) * sizeof(Part));
+
+        Py_ssize_t longest = 0;
+        for (Py_ssize_t j = 0; j < search.nalts[k] && success; j++) {
+            PyObject *str = PySequence_Fast_GET_ITEM(alts[k], j);
+            Part *part = &search.parts[k][j];
+            if (!PyUnicode_Check(str)) {
+                PyErr_SetString(PyExc_TypeError, "Expected a sequence of sequences of strings");
+                success = false;
+            }
+            else if (!(part->str = PyUnicode_AsUTF8AndSize(str, &part->len)))
+                success = false;
+            else if (part->len > longest)
+                longest = part->len;
+        }
+        size += longest;
+    }
+
+    PyObject *ret = NULL;
+    if (success) {
+        search.buffer = (char *)malloc(size);
+        search.prune = SymbolIndex__ready(&__index);
+        success = !PyErr_Occurred() && Search__run(&search, 0, 0, FNV_OFFSET, 0, 1);
+        success = success && !propagate_emacs_error();
+    }
+
+    if (success) {
+        // There are few hits, so sort them by insertion
+        for (Py_ssize_t i = 1; i < search.nhits; i++) {
+            Hit hit = search.hits[i];
+            Py_ssize_t j = i;
+            for (; j > 0 && search.hits[j - 1].rank > hit.rank; j--)
+                search.hits[j] = search.hits[j - 1];
+            search.hits[j] = hit;
+        }
+
+        ret = PyList_New(search.nhits);
+        for (Py_ssize_t i = 0; ret && i < search.nhits; i++) {
+            PyObject *sym = EmacsObject__make(&EmacsObjectType, search.hits[i].sym);
+            if (!sym) {
+                Py_CLEAR(ret);
+                break;
+            }
+            PyList_SET_ITEM(ret, i, sym);
+        }
+    }
+
+    for (Py_ssize_t k = 0; k < n; k++) {
+        Py_XDECREF(alts[k]);
+        free(search.parts[k]);
+    }
+    free(alts);
+    free(search.parts);
+    free(search.nalts);
+    free(search.buffer);
+    free(search.hits);
+    Py_DECREF(seq);
+    return ret;
+}
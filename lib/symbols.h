@@ -0,0 +1,22 @@
+#include <Python.h>
+#include <emacs-module.h>
+
+#include "util.h"
+
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+
+/**
+ * \brief Intern a symbol, keeping the symbol index up to date.
+ */
+emacs_value symbols_intern(const char *name);
+
+EXTERN_DOCSTRING(py_intern_soft)
+PyObject *py_intern_soft(PyObject *self, PyObject *args);
+
+EXTERN_DOCSTRING(py_find_symbols)
+PyObject *py_find_symbols(PyObject *self, PyObject *args);
+
+
+#endif /* SYMBOLS_H */
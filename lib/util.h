@@ -5,5 +5,10 @@
 #define UNUSED(x) (void)(x)
 #define DOCSTRING(symbol, string) static char __doc_ ## symbol[] = string;
 
+// For docstrings used in another file: defined with PUBLIC_DOCSTRING next to
+// the function, and declared with EXTERN_DOCSTRING in its header
+#define PUBLIC_DOCSTRING(symbol, string) char __doc_ ## symbol[] = string;
+#define EXTERN_DOCSTRING(symbol) extern char __doc_ ## symbol[];
+
 
 #endif /* UTIL_H */
@@ -0,0 +1,248 @@
+#include <Python.h>
+
+#include "emacs-interface.h"
+#include "error.h"
+#include "object.h"
+
+#include "vector.h"
+
+
+
+// Element formats
+//
+// Only native formats are supported, as described by the struct module. The
+// size is taken from the buffer itself.
+
+typedef enum {
+    ELEMENT_SIGNED,
+    ELEMENT_UNSIGNED,
+    ELEMENT_FLOAT,
+} ElementKind;
+
+static bool parse_format(Py_buffer *view, ElementKind *kind)
+{
+    const char *format = view->format ? view->format : "B";
+    if (format[0] == '@' || format[0] == '=')
+        format++;
+
+    Py_ssize_t size = view->itemsize;
+    bool valid_int = size == 1 || size == 2 || size == 4 || size == 8;
+
+    if (strlen(format) == 1 && strchr("bhilqn", format[0]) && valid_int)
+        *kind = ELEMENT_SIGNED;
+    else if (strlen(format) == 1 && strchr("BHILQN", format[0]) && valid_int)
+        *kind = ELEMENT_UNSIGNED;
+    else if (strlen(format) == 1 && strchr("fd", format[0]) && (size == 4 || size == 8))
+        *kind = ELEMENT_FLOAT;
+    else {
+        PyErr_Format(PyExc_TypeError, "Unsupported buffer format: '%s'", view->format);
+        return false;
+    }
+    return true;
+}
+
+// Unsigned 64-bit values above INTMAX_MAX become bignums
+static bool read_element(const char *p, ElementKind kind, Py_ssize_t size, emacs_value *ret)
+{
+    if (kind == ELEMENT_FLOAT) {
+        *ret = em_float(size == 4 ? *(const float *)p : *(const double *)p);
+        return true;
+    }
+
+    if (size == 8 && kind == ELEMENT_UNSIGNED && *(const uint64_t *)p > (uint64_t)INTMAX_MAX) {
+        PyObject *big = PyLong_FromUnsignedLongLong(*(const uint64_t *)p);
+        if (!big)
+            return false;
+        bool success = EmacsObject__int(big, ret);
+        Py_DECREF(big);
+        return success;
+    }
+
+    intmax_t val;
+    switch (size) {
+    case 1: val = kind == ELEMENT_SIGNED ? (intmax_t)*(const int8_t *)p : (intmax_t)*(const uint8_t *)p; break;
+    case 2: val = kind == ELEMENT_SIGNED ? (intmax_t)*(const int16_t *)p : (intmax_t)*(const uint16_t *)p; break;
+    case 4: val = kind == ELEMENT_SIGNED ? (intmax_t)*(const int32_t *)p : (intmax_t)*(const uint32_t *)p; break;
+    default: val = kind == ELEMENT_SIGNED ? (intmax_t)*(const int64_t *)p : (intmax_t)*(const uint64_t *)p;
+    }
+    *ret = em_int(val);
+    return true;
+}
+
+static bool write_element(char *p, ElementKind kind, Py_ssize_t size, emacs_value val)
+{
+    emacs_value type = em_type(val);
+
+    if (em_eq(type, em__float)) {
+        if (kind != ELEMENT_FLOAT) {
+            PyErr_SetString(PyExc_TypeError, "Float element in an integer array");
+            return false;
+        }
+        double dbl = em_extract_float(val);
+        if (size == 4)
+            *(float *)p = (float)dbl;
+        else
+            *(double *)p = dbl;
+        return true;
+    }
+
+    if (!em_eq(type, em__integer)) {
+        PyErr_SetString(PyExc_TypeError, "Vector elements must be numbers");
+        return false;
+    }
+
+    intmax_t i;
+    if (!em_extract_int_exact(val, &i)) {
+        // Only unsigned 64-bit elements hold integers beyond intmax_t
+        if (kind == ELEMENT_UNSIGNED && size == 8) {
+            PyObject *big = EmacsObject__pylong(val);
+            unsigned long long u = big ? PyLong_AsUnsignedLongLong(big) : 0;
+            Py_XDECREF(big);
+            if (PyErr_Occurred())
+                return false;
+            *(uint64_t *)p = (uint64_t)u;
+            return true;
+        }
+        PyErr_SetString(PyExc_OverflowError, "Vector element too large");
+        return false;
+    }
+
+    if (kind == ELEMENT_FLOAT) {
+        if (size == 4)
+            *(float *)p = (float)i;
+        else
+            *(double *)p = (double)i;
+        return true;
+    }
+
+    int bits = (int)size * 8;
+    bool fits = kind == ELEMENT_SIGNED
+        ? (bits == 64 || (i >= -((intmax_t)1 << (bits - 1)) && i < ((intmax_t)1 << (bits - 1))))
+        : (i >= 0 && (bits == 64 || i < ((intmax_t)1 << bits)));
+    if (!fits) {
+        PyErr_SetString(PyExc_OverflowError, "Vector element out of range for the array");
+        return false;
+    }
+
+    switch (size) {
+    case 1: *(uint8_t *)p = (uint8_t)i; break;
+    case 2: *(uint16_t *)p = (uint16_t)i; break;
+    case 4: *(uint32_t *)p = (uint32_t)i; break;
+    default: *(uint64_t *)p = (uint64_t)i;
+    }
+    return true;
+}
+
+
+
+// Conversion
+
+bool vector_from_buffer(PyObject *obj, emacs_value *ret)
+{
+    Py_buffer view;
+    if (PyObject_GetBuffer(obj, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0)
+        return false;
+
+    ElementKind kind;
+    if (!parse_format(&view, &kind)) {
+        PyBuffer_Release(&view);
+        return false;
+    }
+
+    Py_ssize_t size = view.len / view.itemsize;
+    emacs_value vec = em_make_vector(size, em__nil);
+    const char *p = (const char *)view.buf;
+    for (Py_ssize_t i = 0; i < size; i++, p += view.itemsize) {
+        emacs_value elt;
+        if (!read_element(p, kind, view.itemsize, &elt)) {
+            PyBuffer_Release(&view);
+            return false;
+        }
+        em_vec_set(vec, i, elt);
+    }
+
+    PyBuffer_Release(&view);
+    if (propagate_emacs_error())
+        return false;
+    *ret = vec;
+    return true;
+}
+
+PUBLIC_DOCSTRING(py_to_array,
+                 "to_array(vec, typecode='q', out=None)\n\n"
+                 "Copies an Emacs vector of numbers to a Python array in one pass.\n\n"
+                 "If `out` is given, it must be a writable object supporting the buffer protocol "
+                 "with room for all the elements, e.g. an :code:`array.array`, a "
+                 ":code:`bytearray` or a :code:`memoryview`, and it is returned. Otherwise a new "
+                 ":code:`array.array` with the given type code is returned.\n\n"
+                 "Integer elements can be copied to integer or floating point arrays, float "
+                 "elements only to floating point arrays.")
+PyObject *py_to_array(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    UNUSED(self);
+    PyObject *vec, *out = Py_None;
+    const char *typecode = "q";
+    char *keywords[] = {"vec", "typecode", "out", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|sO", keywords,
+                                     &EmacsObjectType, &vec, &typecode, &out))
+        return NULL;
+
+    emacs_value val = ((EmacsObject *)vec)->val;
+    if (!em_vectorp(val)) {
+        PyErr_SetString(PyExc_TypeError, "Expected an Emacs vector");
+        return NULL;
+    }
+    ptrdiff_t size = em_vec_size(val);
+
+    if (out == Py_None) {
+        PyObject *module = PyImport_ImportModule("array");
+        PyObject *type = module ? PyObject_GetAttrString(module, "array") : NULL;
+        Py_XDECREF(module);
+        if (!type)
+            return NULL;
+        out = PyObject_CallFunction(type, "s", typecode);
+        Py_DECREF(type);
+        if (!out)
+            return NULL;
+
+        // Grow the new array to the right size
+        PyObject *itemsize = PyObject_GetAttrString(out, "itemsize");
+        PyObject *zeros = itemsize ? PyBytes_FromStringAndSize(NULL, size * PyLong_AsSsize_t(itemsize)) : NULL;
+        Py_XDECREF(itemsize);
+        if (zeros)
+            memset(PyBytes_AS_STRING(zeros), 0, PyBytes_GET_SIZE(zeros));
+        PyObject *res = zeros ? PyObject_CallMethod(out, "frombytes", "O", zeros) : NULL;
+        Py_XDECREF(zeros);
+        if (!res) {
+            Py_DECREF(out);
+            return NULL;
+        }
+        Py_DECREF(res);
+    }
+    else
+        Py_INCREF(out);
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(out, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE) < 0) {
+        Py_DECREF(out);
+        return NULL;
+    }
+
+    ElementKind kind;
+    bool success = parse_format(&view, &kind);
+    if (success && view.len / view.itemsize < size) {
+        PyErr_SetString(PyExc_ValueError, "Output buffer is too small");
+        success = false;
+    }
+
+    char *p = (char *)view.buf;
+    for (ptrdiff_t i = 0; i < size && success; i++, p += view.itemsize)
+        success = write_element(p, kind, view.itemsize, em_vec_get(val, i));
+
+    PyBuffer_Release(&view);
+    if (!success || propagate_emacs_error()) {
+        Py_DECREF(out);
+        return NULL;
+    }
+    return out;
+}
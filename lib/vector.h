@@ -0,0 +1,21 @@
+#include <emacs-module.h>
+#include <Python.h>
+
+#include "util.h"
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+
+/**
+ * \brief Create an Emacs vector of numbers from a Python object supporting
+ * the buffer protocol, such as array.array or bytes.
+ * \return True on success, false with a Python error set otherwise.
+ */
+bool vector_from_buffer(PyObject *obj, emacs_value *ret);
+
+EXTERN_DOCSTRING(py_to_array)
+PyObject *py_to_array(PyObject *self, PyObject *args, PyObject *kwds);
+
+
+#endif /* VECTOR_H */
@@ -0,0 +1,80 @@
+"""Registering Python commands without importing their modules.
+
+Defining a Python function as an Emacs command normally requires importing the
+module that defines it. The functions in this module instead define stubs with
+:func:`emacs_raw.autoload`, which import the module on first use, so that init
+files only pay for the packages that are actually used.
+
+Commands are listed in a manifest, where each entry is either a pair
+:code:`(name, target)` or a dict with the keys *name* and *target*, and
+optionally *interactive* and *doc*. The target has the form
+:code:`'module:function'`.
+
+.. code:: python
+
+   from tripoli import autoload
+
+   autoload.register([
+       ('my-format-buffer', 'mypackage.format:format_buffer'),
+       {'name': 'my-lookup', 'target': 'mypackage.docs:lookup', 'interactive': 'sTerm: '},
+   ])
+
+Packages can also declare commands as entry points, see
+:func:`register_entry_points`.
+"""
+
+import emacs_raw
+
+
+def _parse_target(target):
+    module, _, attr = target.partition(':')
+    attr = attr.split('[')[0].strip()
+    if not module or not attr:
+        raise ValueError("Expected a target of the form 'module:function': {!r}".format(target))
+    return module.strip(), attr
+
+
+def register(manifest, interactive=True):
+    """Define a stub for each command in a manifest.
+
+    :param manifest: An iterable of entries, as described above.
+    :param interactive: The default for entries that don't specify whether
+        they are interactive.
+    :return: The list of symbols defined.
+    """
+    defined = []
+    for entry in manifest:
+        if isinstance(entry, dict):
+            options = dict(entry)
+            name = options.pop('name')
+            target = options.pop('target')
+        else:
+            name, target = entry
+            options = {}
+        options.setdefault('interactive', interactive)
+        module, attr = _parse_target(target)
+        defined.append(emacs_raw.autoload(name, module, attr, **options))
+    return defined
+
+
+def register_entry_points(group='tripoli.commands'):
+    """Define stubs for the commands declared as entry points by installed
+    packages. The name of each entry point is the name of the command, and
+    the commands are interactive. For example, in :code:`setup.cfg`:
+
+    .. code:: ini
+
+       [options.entry_points]
+       tripoli.commands =
+           my-format-buffer = mypackage.format:format_buffer
+
+    :return: The list of symbols defined.
+    """
+    from importlib.metadata import entry_points
+
+    eps = entry_points()
+    if hasattr(eps, 'select'):
+        eps = eps.select(group=group)
+    else:
+        eps = eps.get(group, ())
+    return register((ep.name, ep.value) for ep in eps)
@@ -0,0 +1,206 @@
+"""Reading and editing buffer text in bulk.
+
+Emacs gives modules no direct access to buffer text, so every read copies
+text into an Emacs string and then into Python. The functions in this module
+keep those copies bounded and few: text is read in chunks of a fixed size
+without text properties, searches run entirely in Emacs, and edits are applied
+together in a single call.
+
+Positions are Emacs buffer positions, i.e. one-based character offsets. The
+*buf* argument is a buffer object or a buffer name, and defaults to the
+current buffer.
+"""
+
+from tripoli.util import compiled
+import emacs_raw
+from emacs_raw import intern, byte_compile, add_text_properties, make_overlays
+
+
+_car = intern('car')
+_cdr = intern('cdr')
+_fboundp = intern('fboundp')
+
+_bounds = compiled('''
+(lambda (buf)
+  (with-current-buffer (or buf (current-buffer))
+    (cons (point-min) (point-max))))
+''')
+
+_substring = compiled('''
+(lambda (buf start end)
+  (with-current-buffer (or buf (current-buffer))
+    (buffer-substring-no-properties start end)))
+''')
+
+# Collect the bounds of a match group for every match in one call, as a flat
+# vector [START END START END ...]. Empty matches advance by one character,
+# and an empty match at the bound ends the search.
+_search = compiled('''
+(lambda (buf regexp start end group limit)
+  (with-current-buffer (or buf (current-buffer))
+    (save-excursion
+      (save-match-data
+        (goto-char start)
+        (let (matches (count 0) done)
+          (while (and (not done)
+                      (or (null limit) (< count limit))
+                      (re-search-forward regexp end t))
+            (when (match-beginning group)
+              (setq matches (cons (match-end group)
+                                  (cons (match-beginning group) matches))
+                    count (1+ count)))
+            (when (= (match-beginning 0) (match-end 0))
+              (if (< (point) (or end (point-max)))
+                  (forward-char 1)
+                (setq done t))))
+          (vconcat (nreverse matches)))))))
+''')
+
+# Apply edits, given as (START END TEXT) lists sorted by decreasing START, so
+# that earlier positions stay valid as later text changes. The template is
+# completed with the head of the form that combines the change hooks:
+# combine-change-calls takes the region, combine-after-change-calls only a body.
+_REPLACE = '''
+(lambda (buf edits beg end)
+  (with-current-buffer (or buf (current-buffer))
+    (save-excursion
+      ({}
+        (dolist (edit edits)
+          (goto-char (car edit))
+          (delete-region (car edit) (cadr edit))
+          (insert (nth 2 edit)))))))
+'''
+
+_replace = None
+
+# Apply edits in order as one atomic change
+_apply_edits = compiled('''
+(lambda (buf edits)
+  (with-current-buffer (or buf (current-buffer))
+    (save-excursion
+      (atomic-change-group
+        (dolist (edit edits)
+          (goto-char (car edit))
+          (delete-region (car edit) (cadr edit))
+          (insert (nth 2 edit)))))))
+''')
+
+
+def _bounds_of(buf, start, end):
+    if start is None or end is None:
+        bounds = _bounds(buf)
+        if start is None:
+            start = int(_car(bounds))
+        if end is None:
+            end = int(_cdr(bounds))
+    return start, end
+
+
+def iter_chunks(buf=None, size=65536, start=None, end=None):
+    """Iterate over the text of a buffer in chunks of at most *size*
+    characters, without text properties.
+
+    :param start: The position to start reading from. Defaults to the
+        beginning of the accessible portion of the buffer.
+    :param end: The position to stop reading at. Defaults to the end of the
+        accessible portion of the buffer.
+    """
+    if size <= 0:
+        raise ValueError('Chunk size must be positive')
+    start, end = _bounds_of(buf, start, end)
+    while start < end:
+        stop = min(start + size, end)
+        yield str(_substring(buf, start, stop))
+        start = stop
+
+
+def iter_lines(buf=None, size=65536, start=None, end=None):
+    """Iterate over the lines of a buffer, without newlines and text
+    properties. The text is read in chunks, see :func:`iter_chunks`.
+    """
+    tail = ''
+    for chunk in iter_chunks(buf, size, start, end):
+        lines = (tail + chunk).split('\n')
+        tail = lines.pop()
+        yield from lines
+    if tail:
+        yield tail
+
+
+def search(regexp, buf=None, start=None, end=None, group=0, limit=None):
+    """Find all matches of an Emacs regular expression, using
+    :lisp:`re-search-forward`. All matches are found in a single call to Emacs.
+
+    :param regexp: The regular expression, in Emacs syntax.
+    :param group: The match group to report.
+    :param limit: The maximum number of matches to find.
+    :return: A list of :code:`(start, end)` tuples. Matches where the group
+        didn't participate are skipped.
+    """
+    start, end = _bounds_of(buf, start, end)
+    matches = iter([int(pos) for pos in _search(buf, regexp, start, end, group, limit)])
+    return list(zip(matches, matches))
+
+
+def replace_region(edits, buf=None):
+    """Apply a list of edits to a buffer in a single call to Emacs. Change
+    hooks run once for the whole affected region, using
+    :lisp:`combine-change-calls` where available.
+
+    :param edits: An iterable of :code:`(start, end, text)` tuples, replacing
+        the text between *start* and *end* by *text*. The positions refer to
+        the buffer before any edits are made, and the regions must not
+        overlap.
+    """
+    global _replace
+
+    edits = sorted(((int(s), int(e), str(t)) for s, e, t in edits), reverse=True)
+    if not edits:
+        return
+    for start, end, _ in edits:
+        if end < start:
+            raise ValueError('Invalid region: {}-{}'.format(start, end))
+    for after, before in zip(edits, edits[1:]):
+        if before[1] > after[0]:
+            raise ValueError('Overlapping edits')
+
+    if _replace is None:
+        if _fboundp(intern('combine-change-calls')):
+            _replace = byte_compile(_REPLACE.format('combine-change-calls beg end'))
+        else:
+            _replace = byte_compile(_REPLACE.format('combine-after-change-calls'))
+
+    beg = edits[-1][0]
+    end = max(end for _, end, _ in edits)
+    _replace(buf, emacs_raw.convert(edits), beg, end)
+
+
+def apply_diff(old, new, buf=None, max_cost=1024):
+    """Change the text of a buffer from *old* to *new* with a minimal set of
+    line edits, computed natively by :func:`emacs_raw.diff`. Unlike replacing
+    the whole text, this keeps markers and undo history in unchanged regions,
+    and only the changed regions are refontified.
+
+    The edits are applied from the bottom up, in a single call and inside
+    :lisp:`atomic-change-group`, so either all of them take effect or none do.
+
+    :param old: The current text of the accessible portion of the buffer. If
+        *None*, it is read from the buffer. Raises :code:`ValueError` if its
+        length doesn't match the buffer, since the edits would then be made in
+        the wrong places.
+    :param new: The new text.
+    :return: The number of edits made.
+    """
+    start, end = _bounds_of(buf, None, None)
+    if old is None:
+        old = ''.join(iter_chunks(buf, start=start, end=end))
+    elif len(old) != end - start:
+        raise ValueError('The old text does not match the buffer')
+
+    edits = [
+        (start + s, start + e, text)
+        for s, e, text in emacs_raw.diff(old, new, max_cost=max_cost)
+    ]
+    if edits:
+        _apply_edits(buf, emacs_raw.convert(edits))
+    return len(edits)
@@ -0,0 +1,157 @@
+"""Setting variables and key bindings in bulk.
+
+Init files typically make thousands of small calls to :lisp:`set`,
+:lisp:`define-key` and the like. The functions in this module instead take a
+whole table of settings, convert it to Lisp data in a single pass with
+:func:`emacs_raw.convert`, and apply it with one call to a compiled Lisp
+function.
+
+Variable names are given as keyword arguments, where underscores become dashes,
+or as a dict of exact names:
+
+.. code:: python
+
+   from tripoli import config
+
+   config.setq(fill_column=80, indent_tabs_mode=False)
+   config.setq({'c-basic-offset': 4})
+   config.keys('global-map', {'C-c g': 'magit-status', 'C-x C-b': 'ibuffer'})
+
+Values are converted as by :func:`emacs_raw.convert`: strings stay strings, lists
+and tuples become lists, and dicts become alists. Use :func:`emacs_raw.intern`
+for values that must be symbols.
+
+Settings can be grouped in named sections with :func:`section`, and the time
+spent in each section is reported by :func:`profile`.
+"""
+
+from contextlib import contextmanager
+from time import perf_counter
+
+import emacs_raw
+from emacs_raw import intern
+from tripoli.util import compiled
+
+
+_set = intern('set')
+_set_default = intern('set-default')
+_custom = intern('custom')
+_keys = intern('keys')
+_add_to_list = intern('add-to-list')
+
+_apply = compiled('''
+(lambda (op target items append)
+  (cond
+   ((eq op 'set)
+    (dolist (item items) (set (car item) (cdr item))))
+   ((eq op 'set-default)
+    (dolist (item items) (set-default (car item) (cdr item))))
+   ((eq op 'custom)
+    (dolist (item items) (customize-set-variable (car item) (cdr item))))
+   ((eq op 'keys)
+    (let ((map (if (symbolp target) (symbol-value target) target)))
+      (dolist (item items)
+        (let ((key (car item)))
+          (define-key map
+            (if (vectorp key) key (kbd key))
+            (cdr item))))))
+   ((eq op 'add-to-list)
+    (dolist (item items) (add-to-list target item append)))))
+''')
+
+_profile = []
+_count = 0
+
+
+def _variables(variables, kwargs):
+    table = dict(variables or ())
+    for name, value in kwargs.items():
+        table[name.replace('_', '-')] = value
+    return table
+
+
+def _run(op, target, items, count, append=False):
+    global _count
+    if count:
+        _apply(op, target, items, append)
+        _count += count
+
+
+def setq(variables=None, **kwargs):
+    """Set the values of variables, like :lisp:`setq`.
+
+    :param variables: A dict mapping variable names to values.
+    """
+    table = _variables(variables, kwargs)
+    _run(_set, None, emacs_raw.convert(table, shape=('alist', 'symbol-keys')), len(table))
+
+
+def setq_default(variables=None, **kwargs):
+    """Set the default values of variables, like :lisp:`setq-default`."""
+    table = _variables(variables, kwargs)
+    _run(_set_default, None, emacs_raw.convert(table, shape=('alist', 'symbol-keys')), len(table))
+
+
+def custom(variables=None, **kwargs):
+    """Set the values of user options with :lisp:`customize-set-variable`, so
+    that their :code:`:set` functions run.
+    """
+    table = _variables(variables, kwargs)
+    _run(_custom, None, emacs_raw.convert(table, shape=('alist', 'symbol-keys')), len(table))
+
+
+def keys(keymap, bindings):
+    """Define many keys in a keymap, like :lisp:`define-key`.
+
+    :param keymap: A keymap, or the name of a variable holding one.
+    :param bindings: A dict mapping keys to commands. Keys are strings in the
+        format of :lisp:`kbd`, or Emacs vectors. Commands given as strings
+        become symbols, and *None* removes a binding.
+    """
+    if isinstance(keymap, str):
+        keymap = intern(keymap)
+
+    # Only the commands become symbols, key descriptions stay strings
+    bindings = {
+        key: intern(command) if isinstance(command, str) else command
+        for key, command in bindings.items()
+    }
+    _run(_keys, keymap, emacs_raw.convert(bindings, shape='alist'), len(bindings))
+
+
+def add_to_list(variable, *elements, append=False):
+    """Add elements to the value of a list variable, if not already present,
+    with :lisp:`add-to-list`. Elements are added in order, so without *append*
+    the last one ends up first.
+    """
+    if isinstance(variable, str):
+        variable = intern(variable)
+    _run(_add_to_list, variable, emacs_raw.convert(elements), len(elements), append)
+
+
+@contextmanager
+def section(name):
+    """Record the time spent in a block of configuration under *name*.
+
+    .. code:: python
+
+       with config.section('editing'):
+           config.setq(fill_column=80)
+           config.keys('global-map', {...})
+    """
+    count = _count
+    start = perf_counter()
+    try:
+        yield
+    finally:
+        _profile.append((name, perf_counter() - start, _count - count))
+
+
+def profile():
+    """Return the time spent in each section.
+
+    :return: A list of tuples :code:`(name, time, count)`, in the order the
+        sections finished, where *time* is in seconds and *count* is the
+        number of settings applied in bulk.
+    """
+    return list(_profile)
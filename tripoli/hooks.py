@@ -0,0 +1,166 @@
+"""Running Python functions from Emacs hooks.
+
+Adding a Python function to a hook directly makes Emacs call into Python once
+per function every time the hook runs. This module instead installs a single
+dispatcher function per hook, which runs all the Python functions added to that
+hook in one call from Emacs.
+
+Each function runs separately: if one raises an exception, the error is
+reported with :lisp:`message`, like Emacs does for errors in
+:lisp:`post-command-hook`, and the remaining functions still run. Non-local
+exits that aren't errors, such as :lisp:`throw` and :lisp:`quit`, are not
+caught, and stop the remaining functions. The number of calls, the time spent
+and the number of errors are recorded for each function, see :func:`stats`.
+
+Only hooks whose return values are ignored are supported, i.e. hooks run with
+:lisp:`run-hooks` or :lisp:`run-hook-with-args`. The arguments are passed as
+:class:`.EmacsObject` instances that are only pinned if a function keeps them,
+see :func:`emacs_raw.function`.
+"""
+
+from time import perf_counter
+
+from emacs_raw import EmacsObject, Signal, Throw, intern, function
+
+
+_add_hook = intern('add-hook')
+_remove_hook = intern('remove-hook')
+_message = intern('message')
+_get = intern('get')
+_memq = intern('memq')
+_error = intern('error')
+_error_conditions = intern('error-conditions')
+
+
+def _is_error(exc):
+    """Whether an exception from a hook function is an error, as opposed to a
+    non-local exit that must reach an outer handler.
+    """
+    if isinstance(exc, Throw):
+        return False
+    if isinstance(exc, Signal) and exc.args:
+        try:
+            symbol = EmacsObject(exc.args[0], require_symbol=True)
+        except TypeError:
+            return True
+        return bool(_memq(_error, _get(symbol, _error_conditions)))
+    return True
+
+
+class _Entry:
+
+    __slots__ = ('func', 'calls', 'time', 'errors')
+
+    def __init__(self, func):
+        self.func = func
+        self.calls = 0
+        self.time = 0.0
+        self.errors = 0
+
+
+class Hook:
+    """The Python functions added to a single hook, and the dispatcher that
+    runs them.
+
+    :param symbol: The hook variable, as a symbol.
+    """
+
+    def __init__(self, symbol):
+        self.symbol = symbol
+        self.name = str(symbol)
+        self.entries = []
+        self.dispatcher = function(self._run, raw=True)
+        self.installed = False
+
+    def add(self, func, append=False):
+        if any(entry.func is func for entry in self.entries):
+            return
+        entry = _Entry(func)
+        if append:
+            self.entries.append(entry)
+        else:
+            self.entries.insert(0, entry)
+        if not self.installed:
+            _add_hook(self.symbol, self.dispatcher)
+            self.installed = True
+
+    def remove(self, func):
+        self.entries = [entry for entry in self.entries if entry.func is not func]
+        if not self.entries and self.installed:
+            _remove_hook(self.symbol, self.dispatcher)
+            self.installed = False
+
+    def _run(self, *args):
+        # Functions may add or remove others while running
+        for entry in tuple(self.entries):
+            start = perf_counter()
+            try:
+                entry.func(*args)
+            except Exception as e:
+                if not _is_error(e):
+                    raise
+                entry.errors += 1
+                name = getattr(entry.func, '__qualname__', repr(entry.func))
+                error = '{}: {}'.format(type(e).__name__, e)
+                _message('Error in %s (%s): %s', self.name, name, error)
+            finally:
+                entry.calls += 1
+                entry.time += perf_counter() - start
+
+
+_hooks = {}
+
+
+def _symbol(hook):
+    if isinstance(hook, str):
+        return intern(hook)
+    if not isinstance(hook, EmacsObject):
+        raise TypeError('Expected a hook name or symbol')
+    return hook
+
+
+def add_hook(hook, func, append=False):
+    """Add a Python function to a hook.
+
+    The first function added to a hook installs the dispatcher with
+    :lisp:`add-hook`. Adding a function that is already present does nothing.
+
+    :param hook: The hook, as a name or a symbol.
+    :param func: The function to add.
+    :param append: If true, the function runs after the other Python functions
+        on the hook. Otherwise it runs before them.
+    """
+    symbol = _symbol(hook)
+    name = str(symbol)
+    if name not in _hooks:
+        _hooks[name] = Hook(symbol)
+    _hooks[name].add(func, append=append)
+
+
+def remove_hook(hook, func):
+    """Remove a Python function from a hook. When the last function is
+    removed, the dispatcher is removed with :lisp:`remove-hook`.
+    """
+    hook = _hooks.get(str(_symbol(hook)))
+    if hook:
+        hook.remove(func)
+
+
+def stats(hook=None):
+    """Return statistics for the Python functions on hooks.
+
+    :param hook: If given, only report functions on this hook.
+    :return: A list of tuples :code:`(hook, func, calls, time, errors)`, where
+        *time* is the total time spent in seconds, sorted by decreasing time.
+    """
+    if hook is None:
+        hooks = _hooks.values()
+    else:
+        hook = _hooks.get(str(_symbol(hook)))
+        hooks = [hook] if hook else []
+    result = [
+        (hook.name, entry.func, entry.calls, entry.time, entry.errors)
+        for hook in hooks for entry in hook.entries
+    ]
+    result.sort(key=lambda row: row[3], reverse=True)
+    return result
@@ -53,7 +53,8 @@ def syms(convert=True):
 Returns an iterable of the possible symbols that may be pointed to, in order of
 priority.
 
-:param convert: If true, returns Emacs symbols. If false, return strings.
+:param convert: If true, returns the Emacs symbols that exist. No symbols are
+    created. If false, returns the names of all candidates as strings.
 
 .. code:: python
 
@@ -172,7 +173,7 @@ class EmacsNamespace:
         if item.type_ == 'seps':
             return EmacsNamespace(self.__prefix, *item.args)
         if item.type_ == 'sym':
-            return next(self.__symbols())
+            return emacs_raw.intern(self.__name())
         if item.type_ == 'fbinding':
             return _symbol_function(self.__function_symbol())
         if item.type_ == 'binding':
@@ -216,24 +217,27 @@ class EmacsNamespace:
         return ret
 
     def __symbols(self, convert=True):
-        iters = []
+        # Interning every candidate would fill the obarray with junk symbols
+        if convert:
+            yield from emacs_raw.find_symbols(self.__prefix)
+            return
         for parts in product(*self.__prefix[::-1]):
-            name = ''.join(parts[::-1])
-            if convert: yield emacs_raw.intern(name)
-            else: yield name
+            yield ''.join(parts[::-1])
+
+    def __name(self):
+        return next(self.__symbols(convert=False))
 
     def __symbol_satisfying(self, predicate, exists):
         found = None
         for s in self.__symbols():
             if predicate(s):
-                if found:
+                if found is not None:
                     raise NameError()
                 found = s
         if found is None and exists:
             raise NameError()
         elif found is None:
-            sym = next(self.__symbols())
-            return sym
+            return emacs_raw.intern(self.__name())
         return found
 
     def __function_symbol(self, exists=True):
@@ -260,7 +264,7 @@ class EmacsNamespace:
         _setq(sym, value)
 
     def __repr__(self):
-        return 'EmacsNamespace({})'.format(str(self[sym]))
+        return 'EmacsNamespace({})'.format(self.__name())
 
     def __str__(self):
         try:
@@ -0,0 +1,70 @@
+import emacs_raw
+from emacs_raw import intern
+
+
+_garbage_collect = intern('garbage-collect')
+_symbol_value = intern('symbol-value')
+_get_buffer_create = intern('get-buffer-create')
+_current_buffer = intern('current-buffer')
+_set_buffer = intern('set-buffer')
+_erase_buffer = intern('erase-buffer')
+_insert = intern('insert')
+_goto_char = intern('goto-char')
+_display_buffer = intern('display-buffer')
+
+
+def report_lines(top=20):
+    """Collect a textual report on Emacs global references held by Python,
+    together with Emacs garbage collector statistics.
+
+    This runs a full garbage collection, so that the Emacs heap statistics
+    reflect what is actually reachable.
+
+    :param top: The maximum number of allocation sites to report.
+    """
+    gc = _garbage_collect()
+    stats = emacs_raw.ref_stats(top)
+
+    lines = [
+        'Global references',
+        '  live:     {}'.format(stats['live']),
+        '  objects:  {}'.format(stats['objects']),
+        '  created:  {}'.format(stats['created']),
+        '',
+    ]
+
+    if stats['sites'] is None:
+        lines += ['Allocation sites are not tracked, use emacs_raw.track_refs()', '']
+    else:
+        lines.append('Allocation sites')
+        for filename, lineno, count in stats['sites']:
+            lines.append('  {:>8}  {}:{}'.format(count, filename, lineno))
+        lines.append('')
+
+    lines += [
+        'Emacs heap (after garbage-collect)',
+        '  gcs-done:   {}'.format(_symbol_value(intern('gcs-done'))),
+        '  gc-elapsed: {}'.format(_symbol_value(intern('gc-elapsed'))),
+    ]
+    for entry in gc:
+        lines.append('  {}'.format(entry))
+
+    return lines
+
+
+def report(top=20):
+    """Display the report from :func:`report_lines` in the buffer
+    *tripoli-refs*.
+    """
+    text = '\n'.join(report_lines(top)) + '\n'
+
+    buf = _get_buffer_create('*tripoli-refs*')
+    prev = _current_buffer()
+    _set_buffer(buf)
+    try:
+        _erase_buffer()
+        _insert(text)
+        _goto_char(1)
+    finally:
+        _set_buffer(prev)
+    _display_buffer(buf)
@@ -1,6 +1,6 @@
 from collections.abc import MutableSequence
 
-from tripoli.util import PlaceOrSymbol, coerce
+from tripoli.util import PlaceOrSymbol, coerce, compiled
 from emacs_raw import intern, cons
 
 
@@ -10,6 +10,8 @@ _cdr = intern('cdr')
 _setcar = intern('setcar')
 _setcdr = intern('setcdr')
 
+_nthcdr = compiled('(lambda (list index) (and (>= index 0) (nthcdr index list)))')
+
 
 def _push_head(cell, value):
     tail = cons(_car(cell), _cdr(cell))
@@ -53,11 +55,10 @@ class List(PlaceOrSymbol, MutableSequence):
 
     def _cell(self, index):
         """Retrieve the cons cell at a given index."""
-        for cell in self._cells():
-            if index == 0:
-                return cell
-            index -= 1
-        raise IndexError('List index out of range')
+        cell = _nthcdr(self.place, index)
+        if not cell:
+            raise IndexError('List index out of range')
+        return cell
 
     def __iter__(self):
         for cell in self._cells():
@@ -1,8 +1,8 @@
 from collections import OrderedDict
 from collections.abc import MutableMapping
 
-from tripoli.util import PlaceOrSymbol, coerce
-from emacs_raw import eq, cons, intern
+from tripoli.util import PlaceOrSymbol, coerce, compiled
+from emacs_raw import cons, intern, batch
 
 
 _nil = intern('nil')
@@ -12,6 +12,34 @@ _setcdr = intern('setcdr')
 _keywordp = intern('keywordp')
 _listp = intern('listp')
 
+# Find the first cell holding KEY, returning it and the preceding cell
+_find = compiled('''
+(lambda (cell key)
+  (let (prev)
+    (while (and cell (not (eq (car cell) key)))
+      (setq prev cell cell (cdr cell)))
+    (cons prev cell)))
+''')
+
+# The first cell after CELL holding a keyword, or nil
+_next_key = compiled('''
+(lambda (cell)
+  (setq cell (cdr cell))
+  (while (and cell (not (keywordp (car cell))))
+    (setq cell (cdr cell)))
+  cell)
+''')
+
+# A fresh copy of the values following the key in CELL
+_copy_value = compiled('''
+(lambda (cell)
+  (let (values)
+    (setq cell (cdr cell))
+    (while (and cell (not (keywordp (car cell))))
+      (setq values (cons (car cell) values) cell (cdr cell)))
+    (nreverse values)))
+''')
+
 
 def _colonify(key):
     if _keywordp(key):
@@ -36,11 +64,6 @@ def _copy_list(cell, endp=lambda c: not c):
     return (head or _nil), tail, cell
 
 
-def _copy_value(cell):
-    head, _, _ = _copy_list(_cdr(cell), lambda c: _keywordp(_car(c)))
-    return head
-
-
 class MPList(PlaceOrSymbol, MutableMapping):
 
     def __init__(self, initializer=None, bind=None, prefer_symbol=False, consistent=False):
@@ -84,14 +107,14 @@ class MPList(PlaceOrSymbol, MutableMapping):
 
     def _cell(self, key, cell=None):
         key = _colonify(key)
-        if cell is None:
-            cell = self.place
-        prev = None
-        while cell and not eq(key, _car(cell)):
-            prev, cell = cell, _cdr(cell)
         if not cell:
+            cell = self.place
+        with batch() as b:
+            found = b.call(_find, cell, key)
+            prev, cell = b.call(_car, found), b.call(_cdr, found)
+        if not cell.value:
             raise KeyError("Key '{}' not in mplist".format(key))
-        return prev, cell
+        return prev.value, cell.value
 
     def __getitem__(self, key):
         _, cell = self._cell(key)
@@ -114,10 +137,7 @@ class MPList(PlaceOrSymbol, MutableMapping):
     def __delitem__(self, key):
         prev, cell = self._cell(key)
         while cell:
-            following = _cdr(cell)
-            while following and not _keywordp(_car(following)):
-                following = _cdr(following)
-            # print('prev', prev, 'cell', cell, 'following', following)
+            following = _next_key(cell)
             if prev:
                 _setcdr(prev, following)
             else:
@@ -144,9 +164,7 @@ class MPList(PlaceOrSymbol, MutableMapping):
             except KeyError:
                 pass
             else:
-                cont = _cdr(cell)
-                while cont and not _keywordp(_car(cont)):
-                    cont = _cdr(cont)
+                cont = _next_key(cell)
                 if head:
                     _setcdr(cell, head)
                     _setcdr(tail, cont)
@@ -1,8 +1,8 @@
 from collections import OrderedDict
 from collections.abc import MutableMapping
 
-from tripoli.util import PlaceOrSymbol, coerce
-from emacs_raw import intern, cons, EmacsObject, eq
+from tripoli.util import PlaceOrSymbol, coerce, compiled
+from emacs_raw import intern, cons, EmacsObject, batch
 
 
 _car = intern('car')
@@ -13,6 +13,15 @@ _setcar = intern('setcar')
 _setcdr = intern('setcdr')
 _keywordp = intern('keywordp')
 
+# Find the first key cell for KEY, returning it and the preceding key cell
+_find = compiled('''
+(lambda (cell key)
+  (let (prev)
+    (while (and cell (not (eq (car cell) key)))
+      (setq prev cell cell (cddr cell)))
+    (cons prev cell)))
+''')
+
 
 def _colonify(key):
     if _keywordp(key):
@@ -82,21 +91,21 @@ class PList(PlaceOrSymbol, MutableMapping):
     def _cell(self, key, cell=None):
         """Given a key, return the two key cells *prev* and *cell*, where
         *cell* is the first key cell corresponding to the *key*, and prev is
-        the preceding key cell. *prev* may be *None*.
+        the preceding key cell. *prev* may be :lisp:`nil`.
 
         :param key: The key to search for.
-        :param cell: If given, search starts at this key cell.
+        :param cell: If given and non-nil, search starts at this key cell.
         """
         if self.colonify:
             key = _colonify(key)
-        if cell is None:
+        if not cell:
             cell = self.place
-        prev = None
-        while cell:
-            if eq(_car(cell), key):
-                return prev, cell
-            prev, cell = cell, _cddr(cell)
-        raise KeyError("Key '{}' not in plist".format(key))
+        with batch() as b:
+            found = b.call(_find, cell, key)
+            prev, cell = b.call(_car, found), b.call(_cdr, found)
+        if not cell.value:
+            raise KeyError("Key '{}' not in plist".format(key))
+        return prev.value, cell.value
 
     def __iter__(self):
         for cell in self._cells():
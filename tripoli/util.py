@@ -1,10 +1,12 @@
+from contextlib import contextmanager
 from functools import wraps
 from inspect import signature, Parameter
 import inspect
 from enum import IntEnum
 
 from tripoli.namespace import EmacsNamespace, bound
-from emacs_raw import EmacsObject, intern, symbolp
+from emacs_raw import EmacsObject, intern, symbolp, byte_compile
+from emacs_raw import arithmetic_result as _arithmetic_result
 
 
 class CoercionStrategy(IntEnum):
@@ -92,6 +94,43 @@ def coerce(args=(), invert=False, prefer_symbol=False):
     return decorator
 
 
+def compiled(source):
+    """Return a function that byte-compiles the Lisp lambda form *source* on
+    first use, and calls the compiled function thereafter.
+
+    This is useful for helpers that would otherwise walk Emacs data structures
+    from Python, making one function call per step.
+
+    :param source: Lisp source code for a lambda form.
+    """
+    func = None
+
+    def call(*args):
+        nonlocal func
+        if func is None:
+            func = byte_compile(source)
+        return func(*args)
+    return call
+
+
+@contextmanager
+def arithmetic_result(kind):
+    """Use *kind* for the results of arithmetic on Emacs objects within a block,
+    and restore the previous setting when it exits. See
+    :func:`emacs_raw.arithmetic_result` for the possible kinds.
+
+    .. code:: python
+
+       with arithmetic_result('emacs'):
+           total = sum(sizes, EmacsObject(0))
+    """
+    previous = _arithmetic_result(kind)
+    try:
+        yield
+    finally:
+        _arithmetic_result(previous)
+
+
 class PlaceOrSymbol:
     """A generic class for wrapping an Emacs value that can either be tied to a
     symbol (representing that symbol's value binding) or, otherwise, any other
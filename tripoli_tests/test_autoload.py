@@ -0,0 +1,52 @@
+import pytest
+
+from tripoli import autoload
+import emacs_raw as er
+
+
+_ = er.intern
+symbol_function = _('symbol-function')
+commandp = _('commandp')
+
+calls = []
+
+
+def target(*args):
+    """Target of the autoload tests."""
+    calls.append(args)
+    return len(args)
+
+
+def test_register():
+    name, = autoload.register([('tripoli-test-autoload', 'tripoli_tests.test_autoload:target')])
+    assert er.eq(name, _('tripoli-test-autoload'))
+    assert commandp(name)
+
+    stub = symbol_function(name)
+    assert name(er.int(1), er.int(2)) == 2
+    assert len(calls) == 1
+
+    # The stub has been replaced by the real function
+    assert not er.eq(symbol_function(name), stub)
+    assert commandp(name)
+    assert name(er.int(3)) == 1
+    assert len(calls) == 2
+
+
+def test_register_options():
+    name, = autoload.register([{
+        'name': 'tripoli-test-autoload-plain',
+        'target': 'tripoli_tests.test_autoload:target',
+        'interactive': False,
+    }])
+    assert not commandp(name)
+    assert name() == 0
+
+
+def test_invalid_target():
+    with pytest.raises(ValueError):
+        autoload.register([('tripoli-test-autoload-invalid', 'tripoli_tests.test_autoload')])
+
+    name, = autoload.register([('tripoli-test-autoload-missing', 'tripoli_tests.test_autoload:missing')])
+    with pytest.raises(er.Signal):
+        name()
@@ -0,0 +1,149 @@
+from array import array
+
+import pytest
+
+from tripoli import buffer
+import emacs_raw as er
+
+
+_ = er.intern
+generate_new_buffer = _('generate-new-buffer')
+kill_buffer = _('kill-buffer')
+set_buffer = _('set-buffer')
+current_buffer = _('current-buffer')
+insert = _('insert')
+buffer_string = _('buffer-string')
+
+
+@pytest.fixture
+def buf():
+    buf = generate_new_buffer('tripoli-test')
+    prev = current_buffer()
+    set_buffer(buf)
+    insert('alpha bravo\ncharlie\n\ndelta echo')
+    set_buffer(prev)
+    yield buf
+    kill_buffer(buf)
+
+
+def test_iter_chunks(buf):
+    assert ''.join(buffer.iter_chunks(buf, 4)) == 'alpha bravo\ncharlie\n\ndelta echo'
+    assert list(buffer.iter_chunks(buf, 4, start=1, end=9)) == ['alph', 'a br']
+    assert list(buffer.iter_chunks(buf, 100, start=7, end=12)) == ['bravo']
+
+    with pytest.raises(ValueError):
+        next(buffer.iter_chunks(buf, 0))
+
+
+def test_iter_lines(buf):
+    expected = ['alpha bravo', 'charlie', '', 'delta echo']
+    assert list(buffer.iter_lines(buf)) == expected
+    assert list(buffer.iter_lines(buf, 3)) == expected
+
+
+def test_search(buf):
+    assert buffer.search('[a-z]+o\\b', buf) == [(7, 12), (28, 32)]
+    assert buffer.search('\\(l+\\)\\(x\\)?', buf, group=1) == [(2, 3), (17, 18), (24, 25)]
+    assert buffer.search('\\(l+\\)\\(x\\)?', buf, group=2) == []
+    assert buffer.search('a', buf, limit=2) == [(1, 2), (5, 6)]
+    assert buffer.search('a', buf, start=20, end=28) == [(26, 27)]
+    assert len(buffer.search('^', buf)) == 4
+    assert buffer.search('$', buf, end=12) == [(12, 12)]
+    assert buffer.search('$', buf, start=22) == [(32, 32)]
+
+
+def test_replace_region(buf):
+    buffer.replace_region([(1, 6, 'ALPHA'), (13, 20, 'c'), (22, 22, '>> ')], buf)
+    prev = current_buffer()
+    set_buffer(buf)
+    try:
+        assert str(buffer_string()) == 'ALPHA bravo\nc\n\n>> delta echo'
+    finally:
+        set_buffer(prev)
+
+    with pytest.raises(ValueError):
+        buffer.replace_region([(1, 5, ''), (3, 7, '')], buf)
+    with pytest.raises(ValueError):
+        buffer.replace_region([(5, 1, '')], buf)
+
+
+def test_apply_diff(buf):
+    point_marker = _('point-marker')
+    marker_position = _('marker-position')
+    goto_char = _('goto-char')
+
+    prev = current_buffer()
+    set_buffer(buf)
+    try:
+        goto_char(5)
+        marker = point_marker()
+
+        old = str(buffer_string())
+        new = 'alpha bravo\nCHARLIE\n\ndelta echo\nfoxtrot'
+        assert buffer.apply_diff(old, new) == 2
+        assert str(buffer_string()) == new
+        assert marker_position(marker) == 5
+
+        assert buffer.apply_diff(None, new, buf) == 0
+        assert buffer.apply_diff(None, 'golf', buf) == 1
+        assert str(buffer_string()) == 'golf'
+
+        with pytest.raises(ValueError):
+            buffer.apply_diff('stale text', 'hotel', buf)
+        assert str(buffer_string()) == 'golf'
+    finally:
+        set_buffer(prev)
+
+
+def test_add_text_properties(buf):
+    get_text_property = _('get-text-property')
+    face, bold, italic = _('face'), _('bold'), _('italic')
+    props = {'face': bold}
+
+    assert buffer.add_text_properties([(1, 6), (7, 12, {'face': italic})], props, buf) == 2
+    assert get_text_property(1, face, buf) == bold
+    assert get_text_property(8, face, buf) == italic
+    assert not get_text_property(6, face, buf)
+
+    spans = array('q', [13, 15, 22, 27])
+    assert buffer.add_text_properties(spans, er.list([face, italic]), buf) == 2
+    assert get_text_property(14, face, buf) == italic
+    assert get_text_property(26, face, buf) == italic
+
+    with pytest.raises(ValueError):
+        buffer.add_text_properties(array('q', [1, 2, 3]), props, buf)
+    with pytest.raises(TypeError):
+        buffer.add_text_properties([(1,)], props, buf)
+    with pytest.raises(er.Signal):
+        buffer.add_text_properties([(1, 1000)], props, buf)
+    with pytest.raises(er.Signal):
+        buffer.add_text_properties([(1, 1000), (1,)], props, buf)
+    assert get_text_property(1, face, buf) == bold
+
+    name = str(_('buffer-name')(buf))
+    assert buffer.add_text_properties([(28, 30)], props, name) == 1
+    assert get_text_property(28, face, buf) == bold
+    with pytest.raises(ValueError):
+        buffer.add_text_properties([(1, 2)], props, ' tripoli-no-such-buffer')
+
+
+def test_make_overlays(buf):
+    overlay_get = _('overlay-get')
+    overlay_start = _('overlay-start')
+    overlay_end = _('overlay-end')
+    category = _('category')
+
+    overlays = buffer.make_overlays(
+        array('i', [1, 6, 7, 12]), {'category': _('test'), 'priority': 10}, buf
+    )
+    assert len(overlays) == 2
+    first, second = overlays
+    assert overlay_start(first) == 1 and overlay_end(first) == 6
+    assert overlay_start(second) == 7 and overlay_end(second) == 12
+    assert overlay_get(second, category) == _('test')
+    assert overlay_get(second, _('priority')) == 10
+
+    overlays = buffer.make_overlays([(1, 2, {'category': _('other')}), (3, 4)], buffer=buf)
+    first, second = overlays
+    assert overlay_get(first, category) == _('other')
+    assert not overlay_get(second, category)
@@ -0,0 +1,56 @@
+from tripoli import config
+import emacs_raw as er
+
+
+_ = er.intern
+symbol_value = _('symbol-value')
+default_value = _('default-value')
+make_sparse_keymap = _('make-sparse-keymap')
+lookup_key = _('lookup-key')
+kbd = _('kbd')
+set_ = _('set')
+
+
+def test_setq():
+    config.setq(tripoli_test_alpha=1, tripoli_test_bravo='text')
+    config.setq({'tripoli-test_charlie': [1, 2]})
+    assert symbol_value(_('tripoli-test-alpha')) == 1
+    assert symbol_value(_('tripoli-test-bravo')) == 'text'
+    assert repr(symbol_value(_('tripoli-test_charlie'))) == '(1 2)'
+
+    config.setq_default(tripoli_test_alpha=2)
+    assert default_value(_('tripoli-test-alpha')) == 2
+
+    config.custom(tripoli_test_delta=None)
+    assert not symbol_value(_('tripoli-test-delta'))
+
+
+def test_keys():
+    keymap = make_sparse_keymap()
+    set_(_('tripoli-test-map'), keymap)
+    config.keys('tripoli-test-map', {'C-c a': 'forward-char', 'C-c b': 'backward-char'})
+    config.keys(keymap, {'C-c b': None})
+    assert lookup_key(keymap, kbd('C-c a')) == _('forward-char')
+    assert not lookup_key(keymap, kbd('C-c b'))
+
+    # Key descriptions aren't interned
+    config.keys(keymap, {'C-c M-z': 'forward-char'})
+    assert lookup_key(keymap, kbd('C-c M-z')) == _('forward-char')
+    assert er.intern_soft('C-c M-z') is None
+
+
+def test_add_to_list():
+    set_(_('tripoli-test-list'), er.list([er.int(1)]))
+    config.add_to_list('tripoli-test-list', 2, 1, 3)
+    assert repr(symbol_value(_('tripoli-test-list'))) == '(3 2 1)'
+    config.add_to_list('tripoli-test-list', 4, append=True)
+    assert repr(symbol_value(_('tripoli-test-list'))) == '(3 2 1 4)'
+
+
+def test_profile():
+    with config.section('tripoli-test'):
+        config.setq(tripoli_test_alpha=1, tripoli_test_bravo=2)
+    name, time, count = config.profile()[-1]
+    assert name == 'tripoli-test'
+    assert time >= 0
+    assert count == 2
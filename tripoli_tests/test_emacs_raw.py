@@ -1,6 +1,9 @@
+from array import array
+
 import pytest
 
 import emacs_raw as e
+from tripoli.util import arithmetic_result
 
 
 def test_nil():
@@ -36,6 +39,7 @@ def test_intern():
         float(alpha)
     assert alpha.type() == 'symbol'
     assert alpha.is_a('symbol')
+    assert str(alpha) is str(e.intern('alpha'))
     assert not e.integerp(alpha)
     assert not e.floatp(alpha)
     assert not e.stringp(alpha)
@@ -146,6 +150,8 @@ def test_string():
         float(alpha)
     assert alpha.type() == 'string'
     assert alpha.is_a('string')
+    assert not alpha.is_a('tripoli-no-such-type')
+    assert e.intern_soft('tripoli-no-such-type') is None
     assert not e.integerp(alpha)
     assert not e.floatp(alpha)
     assert e.stringp(alpha)
@@ -167,6 +173,13 @@ def test_string():
     f_two = float(s_two)
     assert f_two == 2.2
 
+    for text in ('a\0b', 'bl\u00e5b\u00e6r\0', '\U0001f600', ''):
+        obj = e.str(text)
+        assert str(obj) == text
+        assert obj == text
+        assert len(obj) == len(text)
+        assert e.EmacsObject(text) == obj
+
 
 def test_cons_ctr():
     a = e.intern('a')
@@ -214,6 +227,75 @@ def test_vector_ctr():
         e.vector()[0]
 
 
+def test_setitem():
+    a, b, c = e.intern('a'), e.intern('b'), e.intern('c')
+
+    vec = e.vector([a, b, c])
+    vec[0] = c
+    vec[-1] = 4
+    assert repr(vec) == '[c b 4]'
+    with pytest.raises(IndexError):
+        vec[3] = a
+
+    lst = e.list([a, b, c])
+    lst[1] = 'x'
+    assert repr(lst) == '(a "x" c)'
+    with pytest.raises(IndexError):
+        lst[3] = a
+    with pytest.raises(IndexError):
+        lst[5] = a
+    with pytest.raises(IndexError):
+        lst[5]
+    with pytest.raises(TypeError):
+        e.cons(a, b)[3] = c
+
+    string = e.str('abc')
+    string[1] = ord('x')
+    assert str(string) == 'axc'
+
+    with pytest.raises(TypeError):
+        del vec[0]
+    with pytest.raises(TypeError):
+        a[0] = b
+
+
+def test_vector_buffer():
+    assert repr(e.vector(array('q', [1, -2, 3]))) == '[1 -2 3]'
+    assert repr(e.vector(array('i', [-5]))) == '[-5]'
+    assert repr(e.vector(b'ab')) == '[97 98]'
+    assert repr(e.vector(array('d', [0.5, -1.5]))) == '[0.5 -1.5]'
+    assert repr(e.vector(memoryview(array('H', [65535])))) == '[65535]'
+    assert e.vector(array('Q', [2**64 - 1]))[0] == 2**64 - 1
+    with pytest.raises(TypeError):
+        e.vector(memoryview(b'ab').cast('c'))
+
+    vec = e.vector(array('q', [1, -2, 3]))
+    assert e.to_array(vec) == array('q', [1, -2, 3])
+    assert e.to_array(vec, 'd') == array('d', [1.0, -2.0, 3.0])
+
+    out = array('i', [0] * 4)
+    assert e.to_array(vec, out=out) is out
+    assert out == array('i', [1, -2, 3, 0])
+
+    with pytest.raises(ValueError):
+        e.to_array(vec, out=array('i', [0]))
+    with pytest.raises(OverflowError):
+        e.to_array(vec, 'B')
+    with pytest.raises(TypeError):
+        e.to_array(e.vector(array('d', [0.5])), 'q')
+    with pytest.raises(TypeError):
+        e.to_array(e.vector([e.intern('a')]))
+    with pytest.raises(TypeError):
+        e.to_array(e.convert([1]))
+
+    big = e.vector(array('Q', [2**64 - 1, 1]))
+    assert e.to_array(big, 'Q') == array('Q', [2**64 - 1, 1])
+    with pytest.raises(OverflowError):
+        e.to_array(big, 'q')
+    with pytest.raises(OverflowError):
+        e.to_array(e.vector([e.int(2**64)]), 'Q')
+
+
 def test_length():
     a = e.intern('a')
     b = e.intern('b')
@@ -358,6 +440,71 @@ def test_function():
     assert e.string_equal(ret, e.str('alpha'))
 
 
+def test_raw_function():
+    def first(a, b):
+        return a
+    func = e.function(first, 2, 2, raw=True)
+    ret = func(e.intern('a'), e.intern('b'))
+    assert e.eq(ret, e.intern('a'))
+
+    # Arguments that escape the call must remain valid afterwards
+    kept = []
+    def keep(a):
+        kept.append(a)
+    func = e.function(keep, 1, 1, raw=True)
+    func(e.str('escaped'))
+    func(e.intern('q'))
+    assert kept[0] == 'escaped'
+    assert e.eq(kept[1], e.intern('q'))
+
+
+def test_handle():
+    state = {'count': 0}
+    h = e.handle(state)
+    assert h.type() == 'user-ptr'
+    assert e.unwrap(h) is state
+
+    def bump(obj, n):
+        obj['count'] += int(n)
+        return obj['count']
+    func = e.function(bump, 2, 2, handles=True)
+    assert func(h, 2) == 2
+    assert state['count'] == 2
+
+    # Without opting in, callbacks receive the handle itself
+    func = e.function(lambda obj: e.unwrap(obj) is state, 1, 1)
+    assert func(h)
+
+    # Handles survive being passed through Lisp data
+    lst = e.list([h, h])
+    assert e.unwrap(lst[1]) is state
+
+    with pytest.raises(TypeError):
+        e.unwrap(e.int(1))
+
+
+def test_convert():
+    assert repr(e.convert([1, 'a', (2.5, None)])) == '(1 "a" (2.5 nil))'
+    assert repr(e.convert([1, 'a'], shape='vector')) == '[1 "a"]'
+    assert repr(e.convert(['a', 'b'], shape=('vector', 'symbol'))) == '[a b]'
+    assert repr(e.convert({'a': 1, 'b': [2]}, shape='alist')) == '(("a" . 1) ("b" 2))'
+    assert repr(e.convert({'a': 'b'}, shape=('alist', 'symbol-keys'))) == '((a . "b"))'
+
+    table = e.convert({'a': 1}, shape='hash-table')
+    assert table.is_a('hash-table')
+    assert e.intern('gethash')(e.str('a'), table) == 1
+
+    with pytest.raises(TypeError):
+        e.convert({'a': 1})
+    with pytest.raises(ValueError):
+        e.convert([], shape='nonsense')
+
+    def pairs():
+        return {'x': [1, 2]}
+    func = e.function(pairs, 0, 0, returns=('alist', 'symbol-keys'))
+    assert repr(func()) == '((x 1 2))'
+
+
 def test_compare():
     assert e.int(0) == e.int(0)
     assert e.int(0) != e.int(1)
@@ -386,6 +533,60 @@ def test_compare():
     with pytest.raises(TypeError):
         e.str('a') >= ()
 
+    assert e.int(2**53 + 1) > float(2**53)
+    assert e.float(0.5) < e.int(1)
+    assert not e.float(float('nan')) == e.float(float('nan'))
+    assert e.float(float('nan')) != 1
+
+    assert e.str('abc') != 'abcd'
+    assert e.str('ab\0c') == 'ab\0c'
+    assert e.str('æøå') == 'æøå'
+    assert e.str('abc') < 'æ'
+    assert e.str('abcd') > 'abc'
+
+
+def test_shared_objects():
+    assert e.EmacsObject() is e.intern('nil')
+    assert e.list() is e.cons() is e.intern('nil')
+    assert e.intern('t') is e.EmacsObject(True)
+    assert e.int(7) is e.int(7)
+    assert e.int(100000) is not e.int(100000)
+
+    prev = e.small_int_range(0, 10)
+    try:
+        assert prev == (-5, 256)
+        assert e.small_int_range() == (0, 10)
+        assert e.int(10) is e.int(10)
+        assert e.int(11) is not e.int(11)
+        assert e.int(10) == 10
+    finally:
+        e.small_int_range(*prev)
+
+    with pytest.raises(TypeError):
+        e.small_int_range(1)
+    with pytest.raises(ValueError):
+        e.small_int_range(0, 10**6)
+
+
+def test_hash():
+    assert hash(e.int(3)) == hash(3)
+    assert hash(e.float(3.0)) == hash(3)
+    assert hash(e.str('abc')) == hash('abc')
+
+    assert hash(e.intern('alpha')) == hash(e.intern('alpha'))
+    symbols = {e.intern('alpha'), e.intern('bravo'), e.intern('alpha')}
+    assert len(symbols) == 2
+    assert e.intern('bravo') in symbols
+
+    # Equal but not eq lists hash alike, with sxhash-equal
+    first, second = e.convert([1, 2]), e.convert([1, 2])
+    assert not e.eq(first, second)
+    assert hash(first) == hash(second)
+    table = {e.str('key'): 1, first: 2}
+    assert table['key'] == 1
+    assert table[second] == 2
+    assert e.convert([1, 3]) not in table
+
 
 def test_num():
     assert e.int(0) + e.int(1) == 1
@@ -427,6 +628,70 @@ def test_num():
     with pytest.raises(TypeError):
         pow(1, 2, e.intern('q'))
 
+    assert e.int(-7) // 2 == -4
+    assert e.int(-7) % 2 == 1
+    assert e.float(-7.5) // 2 == -4.0
+    assert e.int(2) ** 64 == 2 ** 64
+    assert e.int(1) << 70 == 1 << 70
+    with pytest.raises(ZeroDivisionError):
+        e.int(1) // 0
+
+
+def test_bignum():
+    big = 3 ** 100
+    for value in (big, -big, 2 ** 63, -2 ** 63 - 1, 2 ** 64 - 1):
+        obj = e.int(value)
+        assert e.integerp(obj)
+        assert int(obj) == value
+        assert obj == value
+        assert e.EmacsObject(value) == obj
+    assert e.int(big) > 2 ** 64
+    assert float(e.int(2 ** 70)) == float(2 ** 70)
+    assert e.int(big) + 1 == big + 1
+    assert repr(e.int(big)) == str(big)
+
+
+def test_arithmetic_result():
+    assert e.arithmetic_result() == 'python'
+    assert e.arithmetic_result('emacs') == 'python'
+    try:
+        result = e.int(3) + 4
+        assert isinstance(result, e.EmacsObject)
+        assert e.integerp(result) and result == 7
+        assert e.floatp(e.int(7) / 2) and e.int(7) / 2 == 3.5
+        assert divmod(e.int(-7), 2) == (-4, 1)
+        assert e.floatp(-e.float(1.5))
+        assert isinstance('alpha' + e.str('bravo'), str)
+        with pytest.raises(ZeroDivisionError):
+            e.int(1) // 0
+        with pytest.raises(ZeroDivisionError):
+            e.float(1.0) % 0.0
+        with pytest.raises(ValueError):
+            e.int(1) << -1
+        assert e.int(2) ** -1 == 0.5
+        assert e.floatp(e.int(2) ** -1)
+        big = e.int(2) ** 100
+        assert isinstance(big, e.EmacsObject) and big == 2 ** 100
+        assert e.int(1) << 70 == 2 ** 70
+    finally:
+        e.arithmetic_result('python')
+    assert isinstance(e.int(3) + 4, int)
+
+    with pytest.raises(ValueError):
+        e.arithmetic_result('lisp')
+
+    with arithmetic_result('emacs'):
+        assert isinstance(e.int(3) + 4, e.EmacsObject)
+        with arithmetic_result('python'):
+            assert isinstance(e.int(3) + 4, int)
+        assert e.arithmetic_result() == 'emacs'
+    assert e.arithmetic_result() == 'python'
+
+    with pytest.raises(ZeroDivisionError):
+        with arithmetic_result('emacs'):
+            e.int(1) // 0
+    assert e.arithmetic_result() == 'python'
+
 
 def test_error():
     list = e.intern('list')
@@ -458,3 +723,174 @@ def test_error():
     sym, data = ex.value.args
     assert e.eq(sym, e.intern('error'))
     assert e.equal(data, list(e.str('message')))
+
+
+def test_python_error():
+    def err():
+        raise ValueError('bad value')
+    func = e.function(err, 0, 0)
+    with pytest.raises(e.Signal) as ex:
+        func()
+    sym, data = ex.value.args
+    assert e.eq(sym, e.intern('tripoli-python-error'))
+    assert data[0] == 'ValueError'
+    assert data[1] == 'bad value'
+    text = e.intern('tripoli-python-error-traceback')(data[2])
+    assert 'ValueError: bad value' in str(text)
+
+
+def test_ref_stats():
+    e.track_refs()
+    try:
+        before = e.ref_stats()
+        held = [e.int(i) for i in range(10)]
+        after = e.ref_stats()
+        assert after['objects'] == before['objects'] + 10
+        assert after['live'] >= after['objects']
+        assert after['created'] >= before['created'] + 10
+        filename, lineno, count = after['sites'][0]
+        assert filename == __file__
+        assert count >= 10
+        del held
+        assert e.ref_stats()['objects'] == before['objects']
+    finally:
+        e.track_refs(sites=False)
+    assert e.ref_stats()['sites'] is None
+
+
+def test_batch():
+    car, cdr, setcar = e.intern('car'), e.intern('cdr'), e.intern('setcar')
+    a, b, c = e.intern('a'), e.intern('b'), e.intern('c')
+    lst = e.list([a, b, c])
+
+    with e.batch() as batch:
+        second = batch.call(car, batch.call(cdr, lst))
+        batch.call(setcar, batch.call(cdr, batch.call(cdr, lst)), a)
+        with pytest.raises(RuntimeError):
+            second.value
+    assert e.eq(second.value, b)
+    assert repr(lst) == '(a b a)'
+
+    batch = e.batch()
+    first = batch.call('car', lst)
+    batch.run()
+    assert e.eq(first.value, a)
+
+    batch = e.batch()
+    batch.call(car, a)
+    with pytest.raises(e.Signal):
+        batch.run()
+
+    # The signal comes first, and is cleared when an argument fails later
+    batch = e.batch()
+    batch.call(car, a)
+    batch.call(car, object())
+    with pytest.raises(e.Signal):
+        batch.run()
+    assert e.eq(car(lst), a)
+
+    with pytest.raises(ValueError):
+        e.batch().call(car, first)
+
+
+def test_byte_compile():
+    source = '(lambda (list) (let ((n 0)) (dolist (x list n) (setq n (+ n x)))))'
+    func = e.byte_compile(source)
+    assert e.byte_compile(source) is func
+    assert e.intern('byte-code-function-p')(func)
+    assert func(e.convert([1, 2, 3])) == 6
+    assert func(e.convert([])) == 0
+
+    form = e.list([e.intern('lambda'), e.list([e.intern('x')]), e.intern('x')])
+    assert e.byte_compile(form) is e.byte_compile(form)
+    assert e.byte_compile(form)(4) == 4
+
+    with pytest.raises(e.Signal):
+        e.byte_compile('(lambda (x)')
+    with pytest.raises(TypeError):
+        e.byte_compile(1)
+
+
+def test_diff():
+    old = 'alpha\nbravo\ncharlie\ndelta\n'
+    new = 'alpha\nBRAVO\ncharlie\ndelta\necho\n'
+    edits = e.diff(old, new)
+    assert edits == [(26, 26, 'echo\n'), (6, 12, 'BRAVO\n')]
+
+    result = old
+    for start, end, text in edits:
+        result = result[:start] + text + result[end:]
+    assert result == new
+
+    assert e.diff(old, old) == []
+    assert e.diff('', 'x') == [(0, 0, 'x')]
+    assert e.diff(old, new, max_cost=1) == [(6, 26, 'BRAVO\ncharlie\ndelta\necho\n')]
+    with pytest.raises(ValueError):
+        e.diff(old, new, max_cost=-1)
+
+
+def test_sort():
+    lst = e.sort(e.convert([3, 1.5, 2, -4]))
+    assert [int(x * 2) for x in lst] == [-8, 3, 4, 6]
+
+    vec = e.convert(['charlie', 'alpha', 'bravo'], shape='vector')
+    assert e.sort(vec) is vec
+    assert [str(x) for x in vec] == ['alpha', 'bravo', 'charlie']
+
+    # Stable, also in reverse
+    pairs = e.list([
+        e.cons(e.int(k), e.str(v))
+        for k, v in [(1, 'a'), (0, 'b'), (1, 'c'), (0, 'd')]
+    ])
+    car = e.intern('car')
+    cdr = e.intern('cdr')
+    result = e.sort(pairs, key=car, reverse=True)
+    assert [str(cdr(x)) for x in result] == ['a', 'c', 'b', 'd']
+    result = e.sort(result, key=lambda x: str(cdr(x)))
+    assert [str(cdr(x)) for x in result] == ['a', 'b', 'c', 'd']
+
+    result = e.sort(e.convert([1, 3, 2]), predicate=e.intern('>'))
+    assert [int(x) for x in result] == [3, 2, 1]
+    result = e.sort(e.convert(['bb', 'a', 'ccc']), key=len, predicate=lambda a, b: a < b)
+    assert [str(x) for x in result] == ['a', 'bb', 'ccc']
+
+    assert not e.sort(e.convert([]))
+    with pytest.raises(TypeError):
+        e.sort(e.convert([1, 'a']))
+    with pytest.raises(TypeError):
+        e.sort(e.list([e.intern('a')]))
+    with pytest.raises(TypeError):
+        e.sort(e.str('abc'))
+    with pytest.raises(TypeError):
+        e.sort(e.cons(e.int(2), e.int(1)))
+
+
+def test_startup_times():
+    times = e.startup_times()
+    phases = [phase for phase, _ in times]
+    assert phases[:2] == ['python', 'define']
+    assert all(isinstance(seconds, float) and seconds >= 0 for _, seconds in times)
+
+
+def test_intern_soft():
+    assert e.intern_soft('car') == e.intern('car')
+    assert e.intern_soft('nil') is not None
+    assert e.intern_soft('tripoli-surely-missing') is None
+    assert e.intern_soft('tripoli-surely-missing') is None
+
+    seps = ['-', '/']
+    assert e.find_symbols([['emacs'], seps, ['version']]) == [e.intern('emacs-version')]
+    assert e.find_symbols([['tripoli'], seps, ['surely'], seps, ['missing']]) == []
+
+    e.intern('tripoli/sym-a')
+    e.intern('tripoli-sym/a')
+    found = e.find_symbols([['tripoli'], seps, ['sym'], seps, ['a']])
+    assert found == [e.intern('tripoli/sym-a'), e.intern('tripoli-sym/a')]
+
+    # Symbols interned by Lisp aren't in the index, which is then out of date
+    e.intern('intern')(e.str('tripoli-sym-lisp'))
+    e.intern('make-symbol')(e.str('tripoli-sym-uninterned'))
+    assert e.intern_soft('tripoli-sym-lisp') == e.intern('tripoli-sym-lisp')
+    assert e.intern_soft('tripoli-sym-uninterned') is None
+    found = e.find_symbols([['tripoli'], seps, ['sym'], seps, ['lisp']])
+    assert found == [e.intern('tripoli-sym-lisp')]
@@ -0,0 +1,87 @@
+import pytest
+
+from tripoli import hooks
+import emacs_raw as er
+
+
+_ = er.intern
+run_hook_with_args = _('run-hook-with-args')
+symbol_value = _('symbol-value')
+set_ = _('set')
+length = _('length')
+
+
+def test_hooks():
+    hook = _('tripoli-test-hook')
+    set_(hook, _('nil'))
+
+    calls = []
+    def first(arg):
+        calls.append(('first', int(arg)))
+    def failing(arg):
+        raise ValueError('expected')
+    def last(arg):
+        calls.append(('last', int(arg)))
+
+    hooks.add_hook('tripoli-test-hook', first)
+    hooks.add_hook(hook, failing, append=True)
+    hooks.add_hook(hook, last, append=True)
+    hooks.add_hook(hook, first)
+
+    # One dispatcher for all the functions
+    assert int(length(symbol_value(hook))) == 1
+
+    run_hook_with_args(hook, 1)
+    run_hook_with_args(hook, 2)
+    assert calls == [('first', 1), ('last', 1), ('first', 2), ('last', 2)]
+
+    rows = {row[1]: row for row in hooks.stats(hook)}
+    assert set(rows) == {first, failing, last}
+    assert rows[first][0] == 'tripoli-test-hook'
+    assert rows[first][2] == 2
+    assert rows[first][4] == 0
+    assert rows[failing][4] == 2
+
+    hooks.remove_hook(hook, failing)
+    hooks.remove_hook(hook, first)
+    run_hook_with_args(hook, 3)
+    assert calls[-1] == ('last', 3)
+    assert len(calls) == 5
+
+    hooks.remove_hook(hook, last)
+    assert not symbol_value(hook)
+    assert hooks.stats(hook) == []
+
+
+def test_hooks_exits():
+    hook = _('tripoli-test-exit-hook')
+    set_(hook, _('nil'))
+    tag = _('tripoli-test-tag')
+    catch = er.byte_compile(
+        "(lambda (hook) (catch 'tripoli-test-tag (run-hook-with-args hook 1) nil))"
+    )
+
+    calls = []
+    def throwing(arg):
+        raise er.Throw(tag, er.int(7))
+    def quitting(arg):
+        raise er.Signal(_('quit'), _('nil'))
+    def last(arg):
+        calls.append(int(arg))
+
+    hooks.add_hook(hook, last)
+    hooks.add_hook(hook, throwing)
+    assert catch(hook) == 7
+    assert calls == []
+
+    hooks.remove_hook(hook, throwing)
+    hooks.add_hook(hook, quitting)
+    with pytest.raises(er.Signal):
+        run_hook_with_args(hook, 2)
+    assert calls == []
+
+    rows = {row[1]: row for row in hooks.stats(hook)}
+    assert rows[quitting][4] == 0
+
+    hooks.remove_hook(hook, quitting)
+    hooks.remove_hook(hook, last)
@@ -126,6 +126,23 @@ def test_bound():
     assert emacs.doesnt.exist[bound(exists=False)] == e.intern('doesnt-exist')
 
 
+def test_no_intern():
+    import emacs
+    intern_soft = e.intern('intern-soft')
+
+    with pytest.raises(NameError):
+        emacs.tripoli.missing.name[fbound()]
+    assert list(emacs.tripoli.missing.name[syms()]) == []
+    assert 'tripoli-missing-name' in repr(emacs.tripoli.missing.name)
+    for name in emacs.tripoli.missing.name[syms(**a)]:
+        assert not intern_soft(name)
+
+    # Symbols made by Lisp after the index is built are found too
+    e.intern('eval')(e.intern('car')(e.intern('read-from-string')('(defvar tripoli/late-variable 1)')))
+    assert emacs.tripoli.late_variable[binding] == 1
+    assert list(emacs.tripoli.late.variable[syms()]) == [e.intern('tripoli/late-variable')]
+
+
 def test_setattr():
     from emacs import test
 